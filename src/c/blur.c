@@ -3,81 +3,112 @@
 #include "effects.h"
 
 #ifdef PBL_COLOR
-static void blur_(const GBitmap *fb, const GRect fb_bounds, uint16_t row, uint16_t x_start, uint16_t x_end, uint8_t *dest, uint8_t radius){
-  uint16_t total[3];
-  uint8_t  nb_points = 0;
-
-  for (uint16_t x = x_start; x < x_end; ++x) {
-    total[0] = total[1] = total[2] = 0;
-    nb_points = 0;
-    for (int16_t ky = row - radius; ky <= row + radius; ++ky){
-      if(ky>=0 && ky<fb_bounds.size.h){
-        GBitmapDataRowInfo row_info = gbitmap_get_data_row_info(fb, ky);
-        for (int16_t kx = x - radius; kx <= x + radius; ++kx){
-          if(row_info.min_x <= kx && kx <= row_info.max_x)
-          {
-            GColor8 color = (GColor8)*(row_info.data + kx);
-            total[0] += color.r;
-            total[1] += color.g;
-            total[2] += color.b;
-            nb_points++;
-          }
-        }
-      }
+// adds (sign = 1) or removes (sign = -1) source row "ky" to/from per-column sums of columns x0..x1.
+// For every column the row contributes the channels and number of its visible pixels within [x - radius, x + radius],
+// which is kept as a running horizontal sum so the cost does not depend on radius.
+static void blur_accumulate_row(const GBitmap *fb, int16_t ky, int16_t x0, int16_t x1, uint8_t radius, int8_t sign,
+                                int32_t *sum_r, int32_t *sum_g, int32_t *sum_b, int32_t *count) {
+  GBitmapDataRowInfo row_info = gbitmap_get_data_row_info(fb, ky);
+  int32_t r = 0, g = 0, b = 0, n = 0;
+  uint8_t pixel;
+
+  // priming the window with [x0 - radius - 1, x0 + radius - 1], its first column leaves as the loop starts
+  for (int16_t kx = x0 - radius - 1; kx < x0 + radius; ++kx) {
+    if (row_info.min_x <= kx && kx <= row_info.max_x) {
+      pixel = row_info.data[kx];
+      r += (pixel >> 4) & 3; g += (pixel >> 2) & 3; b += pixel & 3; n++;
+    }
+  }
+
+  for (int16_t x = x0; x <= x1; ++x) {
+    int16_t kx = x + radius; // entering the window
+    if (row_info.min_x <= kx && kx <= row_info.max_x) {
+      pixel = row_info.data[kx];
+      r += (pixel >> 4) & 3; g += (pixel >> 2) & 3; b += pixel & 3; n++;
     }
-    total[0] = (total[0] * 0x55) / nb_points;
-    total[1] = (total[1] * 0x55) / nb_points;
-    total[2] = (total[2] * 0x55) / nb_points;
-    dest[x-x_start] = GColorFromRGB(total[0], total[1], total[2]).argb; 
+    kx = x - radius - 1; // leaving the window
+    if (row_info.min_x <= kx && kx <= row_info.max_x) {
+      pixel = row_info.data[kx];
+      r -= (pixel >> 4) & 3; g -= (pixel >> 2) & 3; b -= pixel & 3; n--;
+    }
+    sum_r[x - x0] += sign * r;
+    sum_g[x - x0] += sign * g;
+    sum_b[x - x0] += sign * b;
+    count[x - x0] += sign * n;
   }
 }
+
+// writes blurred row "y" kept in "src" (indexed from column x0) back into the framebuffer
+static void blur_write_row(GBitmap *fb, int16_t y, int16_t x0, int16_t x1, const uint8_t *src) {
+  GBitmapDataRowInfo row_info = gbitmap_get_data_row_info(fb, y);
+  int16_t min_x = row_info.min_x > x0 ? row_info.min_x : x0;
+  int16_t max_x = row_info.max_x < x1 ? row_info.max_x : x1;
+  if (min_x <= max_x) memcpy(row_info.data + min_x, src + (min_x - x0), max_x - min_x + 1);
+}
 #endif
 
 #define max(a,b) a>b?a:b
 #define min(a,b) a>b?b:a
 
+// blur effect.
+// Separable box blur: the (2r+1)x(2r+1) window sum is kept as per-column vertical running sums of per-row
+// horizontal running sums, so each pixel costs the same regardless of radius.
+// Blurred rows are kept in a circular buffer of radius + 2 rows until no longer needed as source.
 void effect_blur(GContext* ctx, GRect position, void* param){
 #ifdef PBL_COLOR
   //capturing framebuffer bitmap
-  GBitmap *fb = graphics_capture_frame_buffer(ctx);
+  GBitmap *fb = effect_capture_frame_buffer(ctx);
   GRect fb_bounds = gbitmap_get_bounds(fb);
 
   uint8_t radius = (uint8_t)(uint32_t)param; // Not very elegant... sorry
-  uint16_t offset_x = position.origin.x;
-  uint16_t offset_y = position.origin.y;
-  uint16_t width    = position.size.w;
-  uint16_t height   = position.size.h;
-  
-  uint8_t *buffer               = malloc(width * (radius + 1));
-  GBitmapDataRowInfo* row_infos = malloc(sizeof(GBitmapDataRowInfo) * (radius + 1));
-  uint8_t circular_index = 0;
-
-  uint16_t h=0;
-  for(; h<radius+1; h++){
-    row_infos[h] = gbitmap_get_data_row_info(fb, offset_y+h);
-    row_infos[h].min_x = max(row_infos[h].min_x, offset_x);
-    row_infos[h].max_x = min(offset_x + width, row_infos[h].max_x);
-    blur_(fb, fb_bounds, offset_y+h, row_infos[h].min_x, row_infos[h].max_x, buffer + h*width, radius);
-  }
 
-  for(; h<height; h++){
-    memcpy(row_infos[circular_index].data + row_infos[circular_index].min_x, buffer + circular_index * width, row_infos[circular_index].max_x - row_infos[circular_index].min_x);
-    row_infos[circular_index] = gbitmap_get_data_row_info(fb, offset_y+h);
-    row_infos[circular_index].min_x = max(row_infos[circular_index].min_x, offset_x);
-    row_infos[circular_index].max_x = min(offset_x + width, row_infos[circular_index].max_x);
-    blur_(fb, fb_bounds, offset_y+h, row_infos[circular_index].min_x, row_infos[circular_index].max_x, buffer + circular_index*width, radius);
-    circular_index = circular_index < radius ? circular_index + 1 : 0;
+  // clipping effect area to the framebuffer
+  int16_t x0 = position.origin.x < 0 ? 0 : position.origin.x;
+  int16_t y0 = position.origin.y < 0 ? 0 : position.origin.y;
+  int16_t x1 = position.origin.x + position.size.w - 1;
+  int16_t y1 = position.origin.y + position.size.h - 1;
+  if (x1 > fb_bounds.size.w - 1) x1 = fb_bounds.size.w - 1;
+  if (y1 > fb_bounds.size.h - 1) y1 = fb_bounds.size.h - 1;
+  if (x0 > x1 || y0 > y1) {
+    effect_release_frame_buffer(ctx, fb);
+    return;
   }
 
-  h=0;
-  for(; h<radius; h++){
-    memcpy(row_infos[circular_index].data + row_infos[circular_index].min_x, buffer + circular_index*width, row_infos[circular_index].max_x - row_infos[circular_index].min_x);
-    circular_index = circular_index < radius ? circular_index + 1 : 0;
+  uint16_t width = x1 - x0 + 1;
+  uint16_t ring_rows = radius + 2;
+
+  int32_t *sums   = effect_scratch_alloc(sizeof(int32_t) * 4 * width);
+  uint8_t *buffer = effect_scratch_alloc(width * ring_rows);
+
+  if (sums && buffer) {
+    int32_t *sum_r = sums, *sum_g = sums + width, *sum_b = sums + 2*width, *count = sums + 3*width;
+    memset(sums, 0, sizeof(int32_t) * 4 * width);
+
+    // window of the first row, except its bottom row which is added in the loop
+    for (int16_t ky = y0 - radius; ky < y0 + radius; ++ky)
+      if (ky >= 0 && ky < fb_bounds.size.h) blur_accumulate_row(fb, ky, x0, x1, radius, 1, sum_r, sum_g, sum_b, count);
+
+    for (int16_t y = y0; y <= y1; ++y) {
+      // sliding window down: adding the entering row, removing the leaving one
+      if (y + radius < fb_bounds.size.h) blur_accumulate_row(fb, y + radius, x0, x1, radius, 1, sum_r, sum_g, sum_b, count);
+      if (y > y0 && y - radius - 1 >= 0) blur_accumulate_row(fb, y - radius - 1, x0, x1, radius, -1, sum_r, sum_g, sum_b, count);
+
+      uint8_t *dest = buffer + (y % ring_rows) * width;
+      for (uint16_t i = 0; i < width; ++i) {
+        if (count[i] > 0) dest[i] = GColorFromRGB((sum_r[i] * 0x55) / count[i], (sum_g[i] * 0x55) / count[i], (sum_b[i] * 0x55) / count[i]).argb;
+      }
+
+      // row y - radius - 1 has just been used as source for the last time
+      if (y - radius - 1 >= y0) blur_write_row(fb, y - radius - 1, x0, x1, buffer + ((y - radius - 1) % ring_rows) * width);
+    }
+
+    // flushing remaining rows
+    for (int16_t y = max(y0, y1 - radius); y <= y1; ++y) blur_write_row(fb, y, x0, x1, buffer + (y % ring_rows) * width);
   }
-  
-  free(buffer);
-  free(row_infos);
-  
-  graphics_release_frame_buffer(ctx, fb);
+
+  effect_scratch_free(buffer);
+  effect_scratch_free(sums);
+
+  effect_release_frame_buffer(ctx, fb);
 #endif
 }
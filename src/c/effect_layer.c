@@ -2,6 +2,7 @@
 #include "effect_layer.h"
 #include "effects.h"  
 
+#ifndef EFFECT_LAYER_CONVERT_POINT
 // Find the offset of parent layer pointer  
 static uint8_t find_parent_offset() {
   Layer* p = layer_create(GRect(0,0,32,32));
@@ -20,27 +21,179 @@ static uint8_t find_parent_offset() {
   layer_destroy(p);
   return i;
 }
+#endif
 
-// on layer update - apply effect
-static void effect_layer_update_proc(Layer *me, GContext* ctx) {
+// screen position of the layer origin, recomputed only when invalidated or when the layer itself was moved
+static GPoint get_screen_origin(EffectLayer *effect_layer, GRect layer_frame) {
+  if(effect_layer->origin_valid && gpoint_equal(&effect_layer->local_origin, &layer_frame.origin)) {
+    return effect_layer->screen_origin;
+  }
+  
+#ifdef EFFECT_LAYER_CONVERT_POINT
+  effect_layer->screen_origin = layer_convert_point_to_screen(effect_layer->layer, GPointZero);
+#else
   static uint8_t parent_layer_offset = 0xff;
   if(parent_layer_offset == 0xff) {
     parent_layer_offset = find_parent_offset();
   }
   
+  effect_layer->screen_origin = layer_frame.origin;
+  Layer* l = effect_layer->layer;
+  while((l=((Layer**)(void*)l)[parent_layer_offset])) {
+    GRect parent_frame = layer_get_frame(l);
+    effect_layer->screen_origin.x += parent_frame.origin.x;
+    effect_layer->screen_origin.y += parent_frame.origin.y;
+  }
+#endif
+  
+  effect_layer->local_origin = layer_frame.origin;
+  effect_layer->origin_valid = true;
+  return effect_layer->screen_origin;
+}
+
+// true if all effects of the layer can run under the compositor's framebuffer capture
+static bool can_composite(EffectLayer *effect_layer) {
+  for(uint8_t i=0; i<MAX_EFFECTS && effect_layer->effects[i]; ++i) {
+    if(effect_draws(effect_layer->effects[i])) return false;
+  }
+  return true;
+}
+
+// grows scratch arena to the most any effect of the layer takes at its frame (effects run one at a time)
+static void size_scratch(EffectLayer *effect_layer) {
+  GRect frame = layer_get_frame(effect_layer->layer);
+  size_t size = 0;
+  for(uint8_t i=0; i<MAX_EFFECTS && effect_layer->effects[i]; ++i) {
+    size_t effect_size = effect_scratch_size(effect_layer->effects[i], effect_layer->params[i], frame);
+    if(effect_size > size) size = effect_size;
+  }
+  
+  if(size > effect_layer->scratch_size) {
+    free(effect_layer->scratch);
+    effect_layer->scratch = malloc(size);
+    effect_layer->scratch_size = effect_layer->scratch ? size : 0;
+  }
+}
+
+// applies effects of the layer at given screen frame
+static void run_effects(EffectLayer *effect_layer, GContext* ctx, GRect layer_frame) {
+  // Applying effects, consecutive color-mapping effects are fused into a single framebuffer pass
+  uint8_t color_map[256];
+  
+  // frame is checked against the screen once: effects of a layer entirely off screen have nothing to change
+  // (effects drawing through the context still run, effect_fps counts frames). Effects get the frame unclipped
+  // since their geometry (mirror axis, zoom and lens center, mask origin) is relative to it, and clip by rows.
+  bool on_screen = layer_frame.origin.x < PBL_DISPLAY_WIDTH && layer_frame.origin.x + layer_frame.size.w > 0 &&
+                   layer_frame.origin.y < PBL_DISPLAY_HEIGHT && layer_frame.origin.y + layer_frame.size.h > 0;
+  
+  uint8_t i = 0;
+  while(i<MAX_EFFECTS && effect_layer->effects[i]) {
+    if(!on_screen && !effect_draws(effect_layer->effects[i])) {
+      ++i;
+      continue;
+    }
+#ifdef EFFECT_LAYER_PROFILE
+    time_t start_s, end_s;
+    uint16_t start_ms, end_ms;
+    time_ms(&start_s, &start_ms);
+#endif
+    effect_scratch_set(effect_layer->scratch, effect_layer->scratch_size);
+    uint8_t fused = 0;
+    while(i+fused<MAX_EFFECTS && effect_layer->effects[i+fused] && effect_compose_color_map(effect_layer->effects[i+fused], effect_layer->params[i+fused], NULL)) ++fused;
+    
+    if(fused > 1) {
+      for(int c=0; c<256; ++c) color_map[c] = c;
+      for(uint8_t j=i; j<i+fused; ++j) effect_compose_color_map(effect_layer->effects[j], effect_layer->params[j], color_map);
+      effect_apply_color_map(ctx, layer_frame, color_map);
+    } else {
+      fused = 1;
+      effect_cache_set(&effect_layer->caches[i]);
+      effect_layer->effects[i](ctx, layer_frame, effect_layer->params[i]);
+      effect_cache_set(NULL);
+    }
+    
+#ifdef EFFECT_LAYER_PROFILE
+    time_ms(&end_s, &end_ms);
+    effect_layer->profile_ms[i] += (end_s - start_s)*1000 + end_ms - start_ms; // fused effects are accounted to the first of them
+#endif
+    i += fused;
+  }
+  effect_scratch_set(NULL, 0);
+  
+#ifdef EFFECT_LAYER_PROFILE
+  // reporting as CSV: effect index, frames, avg us per frame, ns per pixel, pixels per frame. time_ms ticks in
+  // milliseconds, so a single frame of a fast effect reads 0 or 1 ms; averaged over the frames the report comes out
+  // to 1000/EFFECT_LAYER_PROFILE us. Use a large EFFECT_LAYER_PROFILE for fast effects, the host bench
+  // (make -C test bench) to compare implementations.
+  if(++effect_layer->profile_frames == EFFECT_LAYER_PROFILE) {
+    uint32_t pixels = layer_frame.size.w * layer_frame.size.h;
+    for(i=0; i<MAX_EFFECTS && effect_layer->effects[i];++i) {
+      uint64_t total_us = (uint64_t)effect_layer->profile_ms[i] * 1000;
+      APP_LOG(APP_LOG_LEVEL_DEBUG, "effect_profile,%d,%d,%d,%d,%d", i, EFFECT_LAYER_PROFILE, 
+              (int)(total_us / EFFECT_LAYER_PROFILE),
+              pixels ? (int)(total_us * 1000 / EFFECT_LAYER_PROFILE / pixels) : 0, (int)pixels);
+      effect_layer->profile_ms[i] = 0;
+    }
+    effect_layer->profile_frames = 0;
+  }
+#endif
+}
+
+// on layer update - apply effect (or leave it to the compositor)
+static void effect_layer_update_proc(Layer *me, GContext* ctx) {
   // retrieving layer and its real coordinates
   EffectLayer* effect_layer = (EffectLayer*)(layer_get_data(me));
   GRect layer_frame = layer_get_frame(me);
-  Layer* l = me;
-  while((l=((Layer**)(void*)l)[parent_layer_offset])) {
-    GRect parent_frame = layer_get_frame(l);
-    layer_frame.origin.x += parent_frame.origin.x;
-    layer_frame.origin.y += parent_frame.origin.y;
+  layer_frame.origin = get_screen_origin(effect_layer, layer_frame);
+  
+  EffectCompositor *compositor = effect_layer->compositor;
+  if(compositor && compositor->pending_count < MAX_COMPOSITED_LAYERS && can_composite(effect_layer)) {
+    compositor->pending[compositor->pending_count] = effect_layer;
+    compositor->frames[compositor->pending_count] = layer_frame;
+    ++compositor->pending_count;
+    return;
+  }
+  
+  run_effects(effect_layer, ctx, layer_frame);
+}
+
+// drops effect layer from its compositor: from the layers registered with it and from those waiting to be composited
+static void unregister_layer(EffectLayer *effect_layer) {
+  EffectCompositor *compositor = effect_layer->compositor;
+  if(!compositor) return;
+  
+  uint8_t kept = 0;
+  for(uint8_t i=0; i<compositor->pending_count; ++i) {
+    if(compositor->pending[i] == effect_layer) continue;
+    compositor->pending[kept] = compositor->pending[i];
+    compositor->frames[kept] = compositor->frames[i];
+    ++kept;
+  }
+  compositor->pending_count = kept;
+  
+  for(EffectLayer **link = &compositor->registered; *link; link = &(*link)->next_registered) {
+    if(*link == effect_layer) {
+      *link = effect_layer->next_registered;
+      break;
+    }
   }
+  effect_layer->compositor = NULL;
+  effect_layer->next_registered = NULL;
+}
+
+// on compositor update - apply effects of all effect layers drawn this frame, in the order they were drawn
+static void effect_compositor_update_proc(Layer *me, GContext* ctx) {
+  EffectCompositor* compositor = *(EffectCompositor**)layer_get_data(me);
+  if(!compositor->pending_count) return;
   
-  // Applying effects
-  for(uint8_t i=0; effect_layer->effects[i] && i<MAX_EFFECTS;++i) effect_layer->effects[i](ctx, layer_frame, effect_layer->params[i]);
-}  
+  effect_batch_begin(ctx);
+  for(uint8_t i=0; i<compositor->pending_count; ++i) {
+    run_effects(compositor->pending[i], ctx, compositor->frames[i]);
+  }
+  effect_batch_end(ctx);
+  
+  compositor->pending_count = 0;
+}
 
 // create effect layer
 EffectLayer* effect_layer_create(GRect frame) {
@@ -59,9 +212,10 @@ EffectLayer* effect_layer_create(GRect frame) {
 void effect_layer_destroy(EffectLayer *effect_layer) {
   // precaution
   if (effect_layer != NULL && effect_layer->layer != NULL) {
-    layer_destroy(effect_layer->layer);  
-    effect_layer->layer = NULL;
-    effect_layer = NULL;
+    unregister_layer(effect_layer);
+    free(effect_layer->scratch);
+    for(uint8_t i=0; i<MAX_EFFECTS; ++i) effect_cache_free(effect_layer->caches[i]);
+    layer_destroy(effect_layer->layer); // effect_layer itself is the layer's data, so it is gone from here on
   }
   
 }
@@ -74,6 +228,13 @@ Layer* effect_layer_get_layer(EffectLayer *effect_layer){
 //sets frame for effect layer
 void effect_layer_set_frame(EffectLayer *effect_layer, GRect frame) {
   layer_set_frame(effect_layer->layer, frame);
+  effect_layer->origin_valid = false;
+  size_scratch(effect_layer);
+}
+
+//forgets cached screen position of the layer
+void effect_layer_invalidate_origin(EffectLayer *effect_layer) {
+  effect_layer->origin_valid = false;
 }
 
 //adds effect to the layer
@@ -82,6 +243,7 @@ void effect_layer_add_effect(EffectLayer *effect_layer, effect_cb* effect, void*
     effect_layer->effects[effect_layer->next_effect] = effect;
     effect_layer->params[effect_layer->next_effect] = param;  
     ++effect_layer->next_effect;
+    size_scratch(effect_layer);
   }
 }
 
@@ -90,6 +252,46 @@ void effect_layer_remove_effect(EffectLayer *effect_layer) {
   if(effect_layer->next_effect > 0) {
     effect_layer->effects[effect_layer->next_effect - 1] = NULL;
     effect_layer->params[effect_layer->next_effect - 1] = NULL;  
+    effect_cache_free(effect_layer->caches[effect_layer->next_effect - 1]);
+    effect_layer->caches[effect_layer->next_effect - 1] = NULL;
     --effect_layer->next_effect;
   }
-}
\ No newline at end of file
+}
+
+// create effect compositor
+EffectCompositor* effect_compositor_create(GRect frame) {
+  EffectCompositor* compositor = malloc(sizeof(EffectCompositor));
+  if(!compositor) return NULL;
+  memset(compositor,0,sizeof(EffectCompositor));
+  
+  compositor->layer = layer_create_with_data(frame, sizeof(EffectCompositor*));
+  *(EffectCompositor**)layer_get_data(compositor->layer) = compositor;
+  layer_set_update_proc(compositor->layer, effect_compositor_update_proc);
+  
+  return compositor;
+}
+
+//destroy effect compositor
+void effect_compositor_destroy(EffectCompositor *compositor) {
+  if (compositor != NULL) {
+    while(compositor->registered) unregister_layer(compositor->registered);
+    layer_destroy(compositor->layer);
+    free(compositor);
+  }
+}
+
+// returns compositor layer
+Layer* effect_compositor_get_layer(EffectCompositor *compositor) {
+  return compositor->layer;
+}
+
+//registers effect layer with compositor
+void effect_layer_set_compositor(EffectLayer *effect_layer, EffectCompositor *compositor) {
+  unregister_layer(effect_layer);
+  if(compositor) {
+    effect_layer->compositor = compositor;
+    effect_layer->next_registered = compositor->registered;
+    compositor->registered = effect_layer;
+  }
+  layer_mark_dirty(effect_layer->layer);
+}
@@ -4,15 +4,47 @@
   
 //number of supported effects on a single effect_layer (must be <= 255)
 #define MAX_EFFECTS 4
+
+//number of effect layers a compositor can run per frame, the rest run on their own
+#define MAX_COMPOSITED_LAYERS 8
+
+//comment out on SDKs without layer_convert_point_to_screen - screen origin is then found by walking parent layers
+#define EFFECT_LAYER_CONVERT_POINT
+
+//uncomment to log per-effect timing (average us per frame and ns per pixel) every EFFECT_LAYER_PROFILE frames
+//#define EFFECT_LAYER_PROFILE 256
   
+typedef struct EffectCompositor EffectCompositor;
+
 // structure of effect layer
-typedef struct {
+typedef struct EffectLayer {
   Layer*      layer;
+  EffectCompositor* compositor; // when set effects are run by the compositor
+  struct EffectLayer* next_registered; // next effect layer registered with the same compositor
   effect_cb*  effects[MAX_EFFECTS];
   void*       params[MAX_EFFECTS];
   uint8_t     next_effect;
+  bool        origin_valid; // screen_origin is up to date for the layer frame at local_origin
+  GPoint      local_origin;
+  GPoint      screen_origin;
+  uint8_t*    scratch; // scratch arena for effects, sized for the largest of them at the layer frame
+  size_t      scratch_size;
+  EffectCache* caches[MAX_EFFECTS]; // tables each effect keeps between frames, created by the effect on first use
+#ifdef EFFECT_LAYER_PROFILE
+  uint32_t    profile_ms[MAX_EFFECTS]; // time spent in each effect since last report
+  uint16_t    profile_frames; // frames since last report
+#endif
 } EffectLayer;
 
+// structure of effect compositor: layer running effects of registered effect layers under a single framebuffer capture
+struct EffectCompositor {
+  Layer*      layer;
+  EffectLayer* registered; // effect layers registered with the compositor, linked by next_registered
+  EffectLayer* pending[MAX_COMPOSITED_LAYERS]; // effect layers drawn this frame, in z-order
+  GRect       frames[MAX_COMPOSITED_LAYERS]; // their screen frames
+  uint8_t     pending_count;
+};
+
 
 //creates effect layer
 EffectLayer* effect_layer_create(GRect frame);
@@ -32,6 +64,24 @@ Layer* effect_layer_get_layer(EffectLayer *effect_layer);
 //sets effect layer frame
 void effect_layer_set_frame(EffectLayer *effect_layer, GRect frame);
 
+//screen position of the layer is cached - call after adding the layer to another parent or moving any of its parents
+void effect_layer_invalidate_origin(EffectLayer *effect_layer);
+
+//creates effect compositor - its layer has to be added above all effect layers registered with it,
+//their effects are run when the compositor layer is drawn (so they also apply to layers between them and the compositor)
+EffectCompositor* effect_compositor_create(GRect frame);
+
+//destroys effect compositor, effect layers registered with it run their effects on their own again
+void effect_compositor_destroy(EffectCompositor *compositor);
+
+//gets compositor layer
+Layer* effect_compositor_get_layer(EffectCompositor *compositor);
+
+//registers effect layer with compositor (NULL to run its effects on its own again)
+//layers with effects drawing through graphics context (effect_mask, effect_fps) keep running on their own
+//a layer destroyed or unregistered after it was drawn but before the compositor was, is dropped from that frame
+void effect_layer_set_compositor(EffectLayer *effect_layer, EffectCompositor *compositor);
+
 // Recreate inverter_layer for SDK 3
 #ifndef InverterLayer
   #define InverterLayer EffectLayer
@@ -5,6 +5,84 @@
   
 // { ********* Graphics utility functions (probablu should be seaparated into anothe file?) *********
   
+// framebuffer captured for a batch of effects (see effect_batch_begin), NULL when effects capture it themselves
+static GBitmap *s_batch_fb = NULL;
+
+GBitmap* effect_capture_frame_buffer(GContext* ctx) {
+  return s_batch_fb ? s_batch_fb : graphics_capture_frame_buffer(ctx);
+}
+
+void effect_release_frame_buffer(GContext* ctx, GBitmap *fb) {
+  if (fb != s_batch_fb) graphics_release_frame_buffer(ctx, fb);
+}
+
+void effect_batch_begin(GContext* ctx) {
+  s_batch_fb = graphics_capture_frame_buffer(ctx);
+}
+
+void effect_batch_end(GContext* ctx) {
+  if (s_batch_fb) graphics_release_frame_buffer(ctx, s_batch_fb);
+  s_batch_fb = NULL;
+}
+
+// scratch arena set for the running effect (see effect_scratch_set), NULL when effects allocate from heap
+static uint8_t *s_scratch = NULL;
+static size_t s_scratch_size = 0;
+static size_t s_scratch_used = 0;
+
+void effect_scratch_set(uint8_t *arena, size_t size) {
+  s_scratch = arena;
+  s_scratch_size = arena ? size : 0;
+  s_scratch_used = 0;
+}
+
+void* effect_scratch_alloc(size_t size) {
+  size = (size + 3) & ~(size_t)3; // keeping following allocations word-aligned
+  if (s_scratch && s_scratch_used + size <= s_scratch_size) {
+    void *ptr = s_scratch + s_scratch_used;
+    s_scratch_used += size;
+    return ptr;
+  }
+  return malloc(size);
+}
+
+void effect_scratch_free(void *ptr) {
+  // arena memory is given back all at once by the next effect_scratch_set
+  if (s_scratch && (uint8_t *)ptr >= s_scratch && (uint8_t *)ptr < s_scratch + s_scratch_size) return;
+  free(ptr);
+}
+
+// every kind of cache starts with this, destroy frees what it holds and the cache itself
+struct EffectCache {
+  void (*destroy)(EffectCache *cache);
+};
+
+// cache slot set for the running effect (see effect_cache_set), NULL when effects are called on their own
+static EffectCache **s_cache_slot = NULL;
+
+void effect_cache_set(EffectCache **slot) {
+  s_cache_slot = slot;
+}
+
+void effect_cache_free(EffectCache *cache) {
+  if (cache) cache->destroy(cache);
+}
+
+// cache of the running effect, created on first use: in the slot its effect layer set, or in "direct" (one for each
+// kind of cache) when the effect is called on its own. A slot holding another kind of cache is emptied first.
+static EffectCache* get_cache(EffectCache **direct, void (*destroy)(EffectCache *cache), size_t size) {
+  EffectCache **slot = s_cache_slot ? s_cache_slot : direct;
+  if (*slot && (*slot)->destroy != destroy) {
+    effect_cache_free(*slot);
+    *slot = NULL;
+  }
+  if (!*slot) {
+    *slot = calloc(1, size);
+    if (*slot) (*slot)->destroy = destroy;
+  }
+  return *slot;
+}
+  
   
 // set pixel color at given coordinates 
 void set_pixel(BitmapInfo bitmap_info, int y, int x, uint8_t color) {
@@ -70,105 +148,6 @@ uint8_t PalColor(uint8_t in_color, GBitmapFormat in_format, GBitmapFormat out_fo
 }
  
 
-// THE EXTREMELY FAST LINE ALGORITHM Variation E (Addition Fixed Point PreCalc Small Display)
-// Small Display (256x256) resolution.
-// based on algorythm by Po-Han Lin at http://www.edepot.com
-void set_line(BitmapInfo bitmap_info, int y, int x, int y2, int x2, uint8_t draw_color, uint8_t skip_color, uint8_t *visited) {
-  bool yLonger = false; int shortLen=y2-y; int longLen=x2-x;
-  uint8_t temp_pixel;  int temp_x, temp_y;
-  
-  GRect bounds = gbitmap_get_bounds(bitmap_info.bitmap);
-  
-  if (abs(shortLen)>abs(longLen)) {
-    int swap=shortLen;
-    shortLen=longLen; longLen=swap; yLonger=true;
-  }
-  
-  int decInc;
-  if (longLen==0) decInc=0;
-  else decInc = (shortLen << 8) / longLen;
-
-  if (yLonger) {
-    if (longLen>0) {
-      longLen+=y;
-      for (int j=0x80+(x<<8);y<=longLen;++y) {
-        temp_y = y; temp_x = j >> 8;
-        if (temp_y >=bounds.origin.y && temp_y<bounds.size.h && temp_x >=bounds.origin.x && temp_x < bounds.size.w) {
-          temp_pixel = get_pixel(bitmap_info,  temp_y, temp_x);
-          #ifdef PBL_COLOR // for Basalt drawing pixel if it is not of original color or already drawn color
-            if (temp_pixel != skip_color && temp_pixel != draw_color) set_pixel(bitmap_info, temp_y, temp_x, draw_color);
-          #else
-            if (((visited[temp_y*20 + temp_x/8] >> (temp_x % 8)) & 1) != 1) { // for Aplite first check if pixel isn't already marked as set in user-defined array
-              if (temp_pixel != skip_color) set_pixel(bitmap_info, temp_y, temp_x, draw_color); // if pixel isn't of original color - set it
-              draw_color = 1 - draw_color; // revers pixel for "lined" effect
-              visited[temp_y*20 + temp_x/8] ^= (-1 ^ visited[temp_y*20 + temp_x/8]) & (1 << (temp_x % 8)); // in Aplite - set the bit
-            }
-          #endif
-        }
-        j+=decInc;
-      }
-      return;
-    }
-    longLen+=y;
-    for (int j=0x80+(x<<8);y>=longLen;--y) {
-      temp_y = y; temp_x = j >> 8;
-      if (temp_y >=bounds.origin.y && temp_y<bounds.size.h && temp_x >=bounds.origin.x && temp_x < bounds.size.w) {
-        temp_pixel = get_pixel(bitmap_info,  temp_y, temp_x);
-          #ifdef PBL_COLOR // for Basalt drawing pixel if it is not of original color or already drawn color
-            if (temp_pixel != skip_color && temp_pixel != draw_color) set_pixel(bitmap_info, temp_y, temp_x, draw_color);
-          #else
-            if (((visited[temp_y*20 + temp_x/8] >> (temp_x % 8)) & 1) != 1) { // for Aplite first check if pixel isn't already marked as set in user-defined array
-              if (temp_pixel != skip_color) set_pixel(bitmap_info, temp_y, temp_x, draw_color); // if pixel isn't of original color - set it
-              draw_color = 1 - draw_color; // revers pixel for "lined" effect
-              visited[temp_y*20 + temp_x/8] ^= (-1 ^ visited[temp_y*20 + temp_x/8]) & (1 << (temp_x % 8));
-            }
-          #endif
-      }
-      j-=decInc;
-    }
-    return; 
-  }
-
-  if (longLen>0) {
-    longLen+=x;
-    for (int j=0x80+(y<<8);x<=longLen;++x) {
-      temp_y = j >> 8; temp_x =  x;
-      if (temp_y >=bounds.origin.y && temp_y<bounds.size.h && temp_x >=bounds.origin.x && temp_x < bounds.size.w) {
-        temp_pixel = get_pixel(bitmap_info, temp_y, temp_x);
-          #ifdef PBL_COLOR // for Basalt drawing pixel if it is not of original color or already drawn color
-            if (temp_pixel != skip_color && temp_pixel != draw_color) set_pixel(bitmap_info, temp_y, temp_x, draw_color);
-          #else
-            if (((visited[temp_y*20 + temp_x/8] >> (temp_x % 8)) & 1) != 1) { // for Aplite first check if pixel isn't already marked as set in user-defined array
-              if (temp_pixel != skip_color) set_pixel(bitmap_info, temp_y, temp_x, draw_color); // if pixel isn't of original color - set it
-              draw_color = 1 - draw_color; // revers pixel for "lined" effect
-              visited[temp_y*20 + temp_x/8] ^= (-1 ^ visited[temp_y*20 + temp_x/8]) & (1 << (temp_x % 8));
-            }
-          #endif
-      }  
-      j+=decInc;
-    }
-    return;
-  }
-  longLen+=x;
-  for (int j=0x80+(y<<8);x>=longLen;--x) {
-    temp_y = j >> 8; temp_x =  x;
-    if (temp_y >=bounds.origin.y && temp_y<bounds.size.h && temp_x >=bounds.origin.x && temp_x < bounds.size.w) {
-      temp_pixel = get_pixel(bitmap_info, temp_y, temp_x);
-          #ifdef PBL_COLOR // for Basalt drawing pixel if it is not of original color or already drawn color
-            if (temp_pixel != skip_color && temp_pixel != draw_color) set_pixel(bitmap_info, temp_y, temp_x, draw_color);
-          #else
-            if (((visited[temp_y*20 + temp_x/8] >> (temp_x % 8)) & 1) != 1) { // for Aplite first check if pixel isn't already marked as set in user-defined array
-              if (temp_pixel != skip_color) set_pixel(bitmap_info, temp_y, temp_x, draw_color); // if pixel isn't of original color - set it
-              draw_color = 1 - draw_color; // revers pixel for "lined" effect
-              visited[temp_y*20 + temp_x/8] ^= (-1 ^ visited[temp_y*20 + temp_x/8]) & (1 << (temp_x % 8));
-            }
-          #endif
-    }  
-    j-=decInc;
-  }
-
-}
-
 //determine if array of colors contains specific color  
 bool gcolor_contains(GColor *color_array, GColor pixel_color)  {
   int i=0;
@@ -181,6 +160,371 @@ bool gcolor_contains(GColor *color_array, GColor pixel_color)  {
   return false;
 }
 
+// 32-bit word that is allowed to alias framebuffer bytes
+typedef uint32_t __attribute__((__may_alias__)) fb_word_t;
+
+// true if bitmap stores 1 bit per pixel (Aplite framebuffer or 1bit palette bitmap)
+static inline bool is_1bit_format(GBitmapFormat format) {
+  return format == GBitmapFormat1Bit || format == GBitmapFormat1BitPalette;
+}
+
+// framebuffer format is fixed by the platform: 1bit on Aplite, 8bit on color platforms (circular on Chalk). Effects
+// test this constant rather than the captured bitmap's format, so the compiler drops the other format's paths.
+#ifdef PBL_COLOR
+  #define FB_1BIT false
+#else
+  #define FB_1BIT true
+#endif
+
+// gets row "y" of the bitmap with its visible pixels (min_x..max_x) clipped to position horizontally
+// returns false if nothing of the row is visible
+static bool get_row_span(BitmapInfo bitmap_info, int y, GRect position, GBitmapDataRowInfo *span) {
+#ifdef PBL_PLATFORM_CHALK // round framebuffer - row length varies, asking SDK once per row
+  *span = gbitmap_get_data_row_info(bitmap_info.bitmap, y);
+  if (span->min_x < position.origin.x) span->min_x = position.origin.x;
+  if (span->max_x > position.origin.x + position.size.w - 1) span->max_x = position.origin.x + position.size.w - 1;
+#else
+  span->data = bitmap_info.bitmap_data + y*bitmap_info.bytes_per_row;
+  span->min_x = position.origin.x;
+  span->max_x = position.origin.x + position.size.w - 1;
+#endif
+  return span->min_x <= span->max_x;
+}
+
+// gets row y of the framebuffer with its visible pixels, for rows an offset or transform may put beyond the screen:
+// such rows come out empty and false is returned
+static inline bool get_screen_row(BitmapInfo bitmap_info, GRect fb_bounds, int y, GBitmapDataRowInfo *span) {
+  if (y < 0 || y >= fb_bounds.size.h || !get_row_span(bitmap_info, y, fb_bounds, span)) {
+    span->data = NULL; span->min_x = 1; span->max_x = 0;
+    return false;
+  }
+  return true;
+}
+
+// clips rect to bounds, result has size 0 if they don't intersect
+static GRect clip_rect(GRect rect, GRect bounds) {
+  int16_t x0 = rect.origin.x > bounds.origin.x ? rect.origin.x : bounds.origin.x;
+  int16_t y0 = rect.origin.y > bounds.origin.y ? rect.origin.y : bounds.origin.y;
+  int16_t x1 = rect.origin.x + rect.size.w < bounds.origin.x + bounds.size.w ? rect.origin.x + rect.size.w : bounds.origin.x + bounds.size.w;
+  int16_t y1 = rect.origin.y + rect.size.h < bounds.origin.y + bounds.size.h ? rect.origin.y + rect.size.h : bounds.origin.y + bounds.size.h;
+  if (x1 < x0) x1 = x0;
+  if (y1 < y0) y1 = y0;
+  return GRect(x0, y0, x1 - x0, y1 - y0);
+}
+
+// starts iteration over rows of position: effect_row_iterator_next has to be called before the first row
+void effect_row_iterator_init(EffectRowIterator *rows, BitmapInfo bitmap_info, GRect position) {
+  rows->bitmap_info = bitmap_info;
+  rows->area = clip_rect(position, gbitmap_get_bounds(bitmap_info.bitmap));
+  rows->y = rows->area.origin.y - 1;
+  rows->row = NULL;
+  rows->x_start = 0;
+  rows->x_end = -1;
+}
+
+// moves to the next row with visible pixels, returns false when there are no more rows
+bool effect_row_iterator_next(EffectRowIterator *rows) {
+  GBitmapDataRowInfo span;
+  while (++rows->y < rows->area.origin.y + rows->area.size.h) {
+    if (!get_row_span(rows->bitmap_info, rows->y, rows->area, &span)) continue;
+    rows->row = span.data;
+    rows->x_start = span.min_x;
+    rows->x_end = span.max_x;
+    return true;
+  }
+  return false;
+}
+
+// inverts "count" 8bit pixels starting at "data" a 32-bit word at a time (alpha bits are kept set)
+static void invert_row_8bit(uint8_t *data, int count) {
+  // leading bytes until word-aligned
+  while (count > 0 && ((uintptr_t)data & 3)) {
+    *data = ~*data | 0xC0;
+    data++; count--;
+  }
+  
+  fb_word_t *word = (fb_word_t *)data;
+  for (; count >= 4; count -= 4, word++) *word = ~*word | 0xC0C0C0C0;
+  
+  // trailing bytes
+  data = (uint8_t *)word;
+  for (; count > 0; count--, data++) *data = ~*data | 0xC0;
+}
+
+// inverts 1bit pixels x_start..x_end (inclusive) of the row, whole bytes/words at a time
+static void invert_row_1bit(uint8_t *row, int x_start, int x_end) {
+  int first_byte = x_start / 8;
+  int last_byte = x_end / 8;
+  uint8_t first_mask = 0xFF << (x_start % 8); // bits are stored least significant first
+  uint8_t last_mask = 0xFF >> (7 - x_end % 8);
+  
+  if (first_byte == last_byte) {
+    row[first_byte] ^= first_mask & last_mask;
+    return;
+  }
+  
+  row[first_byte] ^= first_mask;
+  row[last_byte] ^= last_mask;
+  
+  // full bytes in between - going by words once aligned
+  uint8_t *data = row + first_byte + 1;
+  int count = last_byte - first_byte - 1;
+  while (count > 0 && ((uintptr_t)data & 3)) {
+    *data++ ^= 0xFF;
+    count--;
+  }
+  fb_word_t *word = (fb_word_t *)data;
+  for (; count >= 4; count -= 4) *word++ ^= 0xFFFFFFFF;
+  for (data = (uint8_t *)word; count > 0; count--) *data++ ^= 0xFF;
+}
+
+// sets pixels x_start..x_end of 1bit row to color (0 or 1), whole bytes at once
+static void fill_row_1bit(uint8_t *row, int x_start, int x_end, uint8_t color) {
+  int first_byte = x_start / 8;
+  int last_byte = x_end / 8;
+  uint8_t first_mask = 0xFF << (x_start % 8);
+  uint8_t last_mask = 0xFF >> (7 - x_end % 8);
+  uint8_t fill = color ? 0xFF : 0;
+  
+  if (first_byte == last_byte) first_mask &= last_mask;
+  row[first_byte] = (row[first_byte] & ~first_mask) | (fill & first_mask);
+  if (first_byte == last_byte) return;
+  
+  row[last_byte] = (row[last_byte] & ~last_mask) | (fill & last_mask);
+  memset(row + first_byte + 1, fill, last_byte - first_byte - 1);
+}
+
+// 1bit rows worked on as arrays of 32-bit words: pixel x is bit x % 32 of word x / 32
+#define MAX_ROW_WORDS 8 // enough for rows up to 256 pixels wide
+
+// gets 32 pixels of 1bit row "bytes" ("count" bytes long) starting at pixel p, pixels outside the row are 0
+static uint32_t bits_get_word(const uint8_t *bytes, int count, int p) {
+  int first = (p - (p & 7)) / 8; // rounding down for negative p as well
+  uint64_t bits = 0;
+  for (int i = 0; i < 5; i++)
+    if (first + i >= 0 && first + i < count) bits |= (uint64_t)bytes[first + i] << (8*i);
+  return (uint32_t)(bits >> (p & 7));
+}
+
+// loads 1bit row into "n" words moved by "shift" pixels: pixel x of words is pixel x - shift of the row
+static void bits_load(uint32_t *words, int n, const uint8_t *bytes, int count, int shift) {
+  for (int i = 0; i < n; i++) words[i] = bits_get_word(bytes, count, i*32 - shift);
+}
+
+// stores words back into first "count" bytes of 1bit row
+static void bits_store(uint8_t *bytes, int count, const uint32_t *words) {
+  for (int b = 0; b < count; b++) bytes[b] = words[b / 4] >> (8 * (b % 4));
+}
+
+// dst = src moved by "shift" pixels (positive moves towards higher x), pixels moved out are dropped
+static void bits_shift(uint32_t *dst, const uint32_t *src, int n, int shift) {
+  int word_shift = (shift - (shift & 31)) / 32, bit_shift = shift & 31;
+  for (int i = 0; i < n; i++) {
+    int j = i - word_shift; // src word landing on low bits of dst word i is j - 1 (when bit_shift > 0) and j
+    uint32_t lo = j - 1 >= 0 && j - 1 < n ? src[j - 1] : 0;
+    uint32_t hi = j >= 0 && j < n ? src[j] : 0;
+    dst[i] = bit_shift ? (hi << bit_shift) | (lo >> (32 - bit_shift)) : hi;
+  }
+}
+
+// keeps only pixels x_start..x_end (inclusive) set in words
+static void bits_clip(uint32_t *words, int n, int x_start, int x_end) {
+  for (int i = 0; i < n; i++) {
+    int lo = x_start - i*32, hi = x_end - i*32;
+    if (hi < 0 || lo > 31 || x_start > x_end) { words[i] = 0; continue; }
+    uint32_t mask = 0xFFFFFFFF;
+    if (lo > 0) mask &= 0xFFFFFFFF << lo;
+    if (hi < 31) mask &= 0xFFFFFFFF >> (31 - hi);
+    words[i] &= mask;
+  }
+}
+
+// sets every pixel within "radius" horizontally of a set pixel, doubling the covered distance on every pass
+static void bits_dilate(uint32_t *words, int n, int radius) {
+  uint32_t left[MAX_ROW_WORDS], right[MAX_ROW_WORDS];
+  for (int covered = 0; covered < radius; ) {
+    int step = covered + 1 < radius - covered ? covered + 1 : radius - covered;
+    bits_shift(left, words, n, -step);
+    bits_shift(right, words, n, step);
+    for (int i = 0; i < n; i++) words[i] |= left[i] | right[i];
+    covered += step;
+  }
+}
+
+// sets pixels marked in "pixels" to "color" (0 or 1) in 1bit row
+static void bits_paint(uint8_t *row, int count, const uint32_t *pixels, int n, uint8_t color) {
+  uint32_t words[MAX_ROW_WORDS];
+  bits_load(words, n, row, count, 0);
+  for (int i = 0; i < n; i++) words[i] = color ? words[i] | pixels[i] : words[i] & ~pixels[i];
+  bits_store(row, count, words);
+}
+
+//  Pixel access: a platform builds for a single framebuffer format (see FB_1BIT), so per-pixel loops go through
+//  row_get_pixel / row_set_pixel without format branches. Round (8bit circular) framebuffer differs from 8bit only
+//  in row spans, which get_row_span resolves once per row.
+
+// gets pixel x of a framebuffer row returned by get_row_span
+static inline uint8_t row_get_pixel(const uint8_t *row, int x) {
+#ifdef PBL_COLOR
+  return row[x];
+#else
+  return (row[x / 8] >> (x % 8)) & 1; // 1bit rows store pixels least significant bit first
+#endif
+}
+
+// sets pixel x of a framebuffer row returned by get_row_span
+static inline void row_set_pixel(uint8_t *row, int x, uint8_t color) {
+#ifdef PBL_COLOR
+  row[x] = color;
+#else
+  row[x / 8] = (row[x / 8] & ~(1 << (x % 8))) | (color << (x % 8));
+#endif
+}
+
+// converts color to the value stored in framebuffer (on 1bit framebuffer white is 1, the rest is black)
+static inline uint8_t pixel_value(GColor color, bool one_bit) {
+  return one_bit ? (gcolor_equal(color, GColorWhite) ? 1 : 0) : color.argb;
+}
+
+// writes draw_color over "count" 8bit pixels starting at "data" that are not skip_color, a 32-bit word at a time
+static void draw_run_8bit(uint8_t *data, int count, uint8_t draw_color, uint8_t skip_color) {
+  // leading bytes until word-aligned
+  while (count > 0 && ((uintptr_t)data & 3)) {
+    if (*data != skip_color) *data = draw_color;
+    data++; count--;
+  }
+  
+  uint32_t draw = draw_color * 0x01010101u, skip = skip_color * 0x01010101u;
+  fb_word_t *word = (fb_word_t *)data;
+  for (; count >= 4; count -= 4, word++) {
+    uint32_t diff = *word ^ skip; // bytes of skip_color are 0
+    uint32_t keep = ~(((diff & 0x7F7F7F7F) + 0x7F7F7F7F) | diff) & 0x80808080; // top bit of every 0 byte
+    keep = (keep >> 7) * 0xFF;
+    *word = (*word & keep) | (draw & ~keep);
+  }
+  
+  // trailing bytes
+  data = (uint8_t *)word;
+  for (; count > 0; count--, data++) if (*data != skip_color) *data = draw_color;
+}
+
+// writes 32 pixels of 1bit row ("count" bytes long) starting at pixel p (multiple of 8), bytes past the row are left alone
+static void bits_put_word(uint8_t *bytes, int count, int p, uint32_t word) {
+  for (int b = 0; b < 4 && p / 8 + b < count; b++) bytes[p / 8 + b] = word >> (8 * b);
+}
+
+// draws pixels x_start..x_end of 1bit row, traversed from x_start when forward (from x_end otherwise): pixels that are
+// not skip_color get draw_color. When lined, only pixels not yet marked in visited row (if any) are drawn - draw_color
+// alternates from one such pixel to the next and they get marked. Returns draw_color for the next pixel of the line.
+static uint8_t draw_run_1bit(uint8_t *row, uint8_t *visited, int count, int x_start, int x_end, bool forward, bool lined,
+                             uint8_t draw_color, uint8_t skip_color) {
+  int first = x_start / 32, last = x_end / 32;
+  for (int k = first; k <= last; k++) {
+    int i = forward ? k : first + last - k;
+    uint32_t fresh = 0xFFFFFFFF;
+    if (i == first) fresh &= 0xFFFFFFFF << (x_start % 32);
+    if (i == last) fresh &= 0xFFFFFFFF >> (31 - x_end % 32);
+    
+    uint32_t color = draw_color ? 0xFFFFFFFF : 0;
+    if (lined) {
+      uint32_t marked = visited ? bits_get_word(visited, count, i*32) : 0;
+      fresh &= ~marked;
+      // every fresh pixel flips the color of the ones after it: prefix parity of fresh pixels in drawing order
+      uint32_t parity = fresh;
+      if (forward) {
+        parity ^= parity << 1; parity ^= parity << 2; parity ^= parity << 4; parity ^= parity << 8; parity ^= parity << 16;
+      } else {
+        parity ^= parity >> 1; parity ^= parity >> 2; parity ^= parity >> 4; parity ^= parity >> 8; parity ^= parity >> 16;
+      }
+      color ^= parity ^ fresh;
+      if (__builtin_popcount(fresh) & 1) draw_color = 1 - draw_color;
+      if (visited) bits_put_word(visited, count, i*32, marked | fresh);
+    }
+    
+    uint32_t pixels = bits_get_word(row, count, i*32);
+    uint32_t drawn = fresh & (skip_color ? ~pixels : pixels); // pixels that are not skip_color
+    bits_put_word(row, count, i*32, (pixels & ~drawn) | (color & drawn));
+  }
+  return draw_color;
+}
+
+// floor of a / b for any signs
+static int floor_div(int a, int b) {
+  int q = a / b;
+  return (a % b != 0 && (a < 0) != (b < 0)) ? q - 1 : q;
+}
+
+// narrows steps k0..k1 to those where lo <= start + k*step <= hi
+static void clip_steps(int *k0, int *k1, int start, int step, int lo, int hi) {
+  if (step == 0) {
+    if (start < lo || start > hi) *k1 = *k0 - 1;
+    return;
+  }
+  int k_lo = step > 0 ? -floor_div(start - lo, step) : -floor_div(start - hi, step); // ceil((bound - start) / step)
+  int k_hi = step > 0 ? floor_div(hi - start, step) : floor_div(lo - start, step);
+  if (k_lo > *k0) *k0 = k_lo;
+  if (k_hi < *k1) *k1 = k_hi;
+}
+
+// THE EXTREMELY FAST LINE ALGORITHM Variation E (Addition Fixed Point PreCalc Small Display)
+// Small Display (256x256) resolution.
+// based on algorythm by Po-Han Lin at http://www.edepot.com
+// Line is clipped to the bitmap once (in steps along its longer axis) and drawn as runs of pixels sharing a row:
+// on color pixels that are not skip_color get draw_color, on Aplite pixels not yet marked in "visited" (1 bit per
+// pixel, laid out as the framebuffer) are drawn alternating draw_color for "lined" effect unless they are skip_color.
+void set_line(BitmapInfo bitmap_info, int y, int x, int y2, int x2, uint8_t draw_color, uint8_t skip_color, uint8_t *visited) {
+  GRect bounds = gbitmap_get_bounds(bitmap_info.bitmap);
+  
+  bool yLonger = abs(y2 - y) > abs(x2 - x);
+  int longLen = yLonger ? y2 - y : x2 - x;
+  int shortLen = yLonger ? x2 - x : y2 - y;
+  int dir = longLen < 0 ? -1 : 1;
+  int decInc = longLen ? shortLen * 256 / longLen : 0;
+  
+  // step k is at major + dir*k along the longer axis and (j + k*step) >> 8 along the shorter one
+  int major = yLonger ? y : x;
+  int j = 0x80 + (yLonger ? x : y) * 256;
+  int step = dir * decInc;
+  
+  int k0 = 0, k1 = abs(longLen);
+  clip_steps(&k0, &k1, major, dir, 0, (yLonger ? bounds.size.h : bounds.size.w) - 1);
+  clip_steps(&k0, &k1, j, step, 0, (yLonger ? bounds.size.w : bounds.size.h) * 256 - 1);
+  
+  bool one_bit = is_1bit_format(bitmap_info.bitmap_format);
+#ifdef PBL_COLOR
+  bool lined = false;
+  visited = NULL;
+#else
+  bool lined = true;
+#endif
+  
+  GBitmapDataRowInfo span;
+  for (int k = k0, end; k <= k1; k = end + 1) {
+    int minor = (j + k*step) >> 8;
+    int row_y, x_start, x_end;
+    
+    if (yLonger) { // a pixel per row
+      end = k;
+      row_y = major + dir*k;
+      x_start = x_end = minor;
+    } else { // run goes on until the shorter coordinate changes
+      end = step == 0 ? k1 : k + floor_div(step > 0 ? (minor + 1) * 256 - 1 - (j + k*step) : minor * 256 - (j + k*step), step);
+      if (end > k1) end = k1;
+      row_y = minor;
+      x_start = major + dir * (dir > 0 ? k : end);
+      x_end = major + dir * (dir > 0 ? end : k);
+    }
+    
+    if (!get_row_span(bitmap_info, row_y, GRect(x_start, row_y, x_end - x_start + 1, 1), &span)) continue;
+    if (one_bit) {
+      draw_color = draw_run_1bit(span.data, visited ? visited + row_y * bitmap_info.bytes_per_row : NULL, bitmap_info.bytes_per_row,
+                                 span.min_x, span.max_x, yLonger || dir > 0, lined, draw_color, skip_color);
+    } else {
+      draw_run_8bit(span.data + span.min_x, span.max_x - span.min_x + 1, draw_color, skip_color);
+    }
+  }
+}
+
 //  ********* Graphics utility functions (probablu should be seaparated into anothe file?) ********* }
 
   
@@ -188,7 +532,7 @@ bool gcolor_contains(GColor *color_array, GColor pixel_color)  {
 // inverter effect.
 void effect_invert(GContext* ctx,  GRect position, void* param) {
   //capturing framebuffer bitmap
-  GBitmap *fb = graphics_capture_frame_buffer(ctx);
+  GBitmap *fb = effect_capture_frame_buffer(ctx);
   
   BitmapInfo bitmap_info;
   bitmap_info.bitmap = fb;
@@ -196,25 +540,209 @@ void effect_invert(GContext* ctx,  GRect position, void* param) {
   bitmap_info.bytes_per_row = gbitmap_get_bytes_per_row(fb);
   bitmap_info.bitmap_format = gbitmap_get_format(fb);
   
-  for (int y = 0; y < position.size.h; y++)
-     for (int x = 0; x < position.size.w; x++)
-        #ifdef PBL_COLOR // on Basalt simple doing NOT on entire returned byte/pixel
-          set_pixel(bitmap_info, y + position.origin.y, x + position.origin.x, (~get_pixel(bitmap_info, y + position.origin.y, x + position.origin.x))|11000000);
-        #else // on Aplite since only 1 and 0 is returning, doing "not" by 1 - pixel
-          set_pixel(bitmap_info, y + position.origin.y, x + position.origin.x, 1 - get_pixel(bitmap_info, y + position.origin.y, x + position.origin.x));
-        #endif
+  // resolving format once per frame instead of once per pixel
+  bool one_bit = FB_1BIT;
+  EffectRowIterator rows;
+  effect_row_iterator_init(&rows, bitmap_info, position);
+  
+  while (effect_row_iterator_next(&rows)) {
+     if (one_bit) // on Aplite flipping whole bytes/words of bits
+       invert_row_1bit(rows.row, rows.x_start, rows.x_end);
+     else // on Basalt doing NOT on entire bytes/words, keeping alpha bits
+       invert_row_8bit(rows.row + rows.x_start, rows.x_end - rows.x_start + 1);
+  }
  
-  graphics_release_frame_buffer(ctx, fb);          
+  effect_release_frame_buffer(ctx, fb);          
           
 }
 
+// applies single color-mapping effect through its color map
+static void apply_effect_color_map(GContext* ctx, GRect position, effect_cb *effect, void *param) {
+  uint8_t map[256];
+  for (int c = 0; c < 256; c++) map[c] = c;
+  effect_compose_color_map(effect, param, map);
+  effect_apply_color_map(ctx, position, map);
+}
+
 // colorize effect - given a target color, replace it with a new color
 // Added by Martin Norland (@cynorg)
 // Parameter:  GColor firstColor, GColor secondColor
 void effect_colorize(GContext* ctx,  GRect position, void* param) {
 #ifdef PBL_COLOR // only logical to do anything on Basalt - otherwise you're just ... drawing a black|white GRect
+  apply_effect_color_map(ctx, position, effect_colorize, param);
+#endif
+}
+
+
+// colorswap effect - swaps two colors in a given area
+// Added by Martin Norland (@cynorg)
+// Parameter:  GColor firstColor, GColor secondColor
+void effect_colorswap(GContext* ctx,  GRect position, void* param) {
+#ifdef PBL_COLOR // only logical to do anything on Basalt - otherwise you're just ... doing an invert
+  apply_effect_color_map(ctx, position, effect_colorswap, param);
+#endif
+}
+
+// invert black and white only (leaves all other colors intact).
+// on Aplite since only 1 and 0 is there it is a plain invert
+void effect_invert_bw_only(GContext* ctx,  GRect position, void* param) {
+  apply_effect_color_map(ctx, position, effect_invert_bw_only, param);
+}
+
+// brightness inversion as a palette map: handcrafted opposing brightness of every color (color spread is not even,
+// so it is probably subjective and open for improvement). Black, white and non-opaque values map to themselves.
+const uint8_t effect_invert_brightness_map[256] = {
+  0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F,
+  0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0x1A, 0x1B, 0x1C, 0x1D, 0x1E, 0x1F,
+  0x20, 0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27, 0x28, 0x29, 0x2A, 0x2B, 0x2C, 0x2D, 0x2E, 0x2F,
+  0x30, 0x31, 0x32, 0x33, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x3B, 0x3C, 0x3D, 0x3E, 0x3F,
+  0x40, 0x41, 0x42, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49, 0x4A, 0x4B, 0x4C, 0x4D, 0x4E, 0x4F,
+  0x50, 0x51, 0x52, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5A, 0x5B, 0x5C, 0x5D, 0x5E, 0x5F,
+  0x60, 0x61, 0x62, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6A, 0x6B, 0x6C, 0x6D, 0x6E, 0x6F,
+  0x70, 0x71, 0x72, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7A, 0x7B, 0x7C, 0x7D, 0x7E, 0x7F,
+  0x80, 0x81, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89, 0x8A, 0x8B, 0x8C, 0x8D, 0x8E, 0x8F,
+  0x90, 0x91, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9A, 0x9B, 0x9C, 0x9D, 0x9E, 0x9F,
+  0xA0, 0xA1, 0xA2, 0xA3, 0xA4, 0xA5, 0xA6, 0xA7, 0xA8, 0xA9, 0xAA, 0xAB, 0xAC, 0xAD, 0xAE, 0xAF,
+  0xB0, 0xB1, 0xB2, 0xB3, 0xB4, 0xB5, 0xB6, 0xB7, 0xB8, 0xB9, 0xBA, 0xBB, 0xBC, 0xBD, 0xBE, 0xBF,
+  [GColorBlackARGB8] = GColorBlackARGB8,
+  [GColorOxfordBlueARGB8] = GColorCelesteARGB8,
+  [GColorDukeBlueARGB8] = GColorVividCeruleanARGB8,
+  [GColorBlueARGB8] = GColorPictonBlueARGB8,
+  [GColorDarkGreenARGB8] = GColorMintGreenARGB8,
+  [GColorMidnightGreenARGB8] = GColorMediumSpringGreenARGB8,
+  [GColorCobaltBlueARGB8] = GColorCyanARGB8,
+  [GColorBlueMoonARGB8] = GColorElectricBlueARGB8,
+  [GColorIslamicGreenARGB8] = GColorMalachiteARGB8,
+  [GColorJaegerGreenARGB8] = GColorScreaminGreenARGB8,
+  [GColorTiffanyBlueARGB8] = GColorCadetBlueARGB8,
+  [GColorVividCeruleanARGB8] = GColorDukeBlueARGB8,
+  [GColorGreenARGB8] = GColorMayGreenARGB8,
+  [GColorMalachiteARGB8] = GColorIslamicGreenARGB8,
+  [GColorMediumSpringGreenARGB8] = GColorMidnightGreenARGB8,
+  [GColorCyanARGB8] = GColorCobaltBlueARGB8,
+  [GColorBulgarianRoseARGB8] = GColorMelonARGB8,
+  [GColorImperialPurpleARGB8] = GColorRichBrilliantLavenderARGB8,
+  [GColorIndigoARGB8] = GColorLavenderIndigoARGB8,
+  [GColorElectricUltramarineARGB8] = GColorVeryLightBlueARGB8,
+  [GColorArmyGreenARGB8] = GColorBrassARGB8,
+  [GColorDarkGrayARGB8] = GColorLightGrayARGB8,
+  [GColorLibertyARGB8] = GColorBabyBlueEyesARGB8,
+  [GColorVeryLightBlueARGB8] = GColorElectricUltramarineARGB8,
+  [GColorKellyGreenARGB8] = GColorGreenARGB8,
+  [GColorMayGreenARGB8] = GColorMediumAquamarineARGB8,
+  [GColorCadetBlueARGB8] = GColorTiffanyBlueARGB8,
+  [GColorPictonBlueARGB8] = GColorBlueARGB8,
+  [GColorBrightGreenARGB8] = GColorIslamicGreenARGB8,
+  [GColorScreaminGreenARGB8] = GColorKellyGreenARGB8,
+  [GColorMediumAquamarineARGB8] = GColorMayGreenARGB8,
+  [GColorElectricBlueARGB8] = GColorBlueMoonARGB8,
+  [GColorDarkCandyAppleRedARGB8] = GColorMelonARGB8,
+  [GColorJazzberryJamARGB8] = GColorBrilliantRoseARGB8,
+  [GColorPurpleARGB8] = GColorShockingPinkARGB8,
+  [GColorVividVioletARGB8] = GColorPurpureusARGB8,
+  [GColorWindsorTanARGB8] = GColorRoseValeARGB8,
+  [GColorRoseValeARGB8] = GColorWindsorTanARGB8,
+  [GColorPurpureusARGB8] = GColorVividVioletARGB8,
+  [GColorLavenderIndigoARGB8] = GColorIndigoARGB8,
+  [GColorLimerickARGB8] = GColorPastelYellowARGB8,
+  [GColorBrassARGB8] = GColorArmyGreenARGB8,
+  [GColorLightGrayARGB8] = GColorDarkGrayARGB8,
+  [GColorBabyBlueEyesARGB8] = GColorLibertyARGB8,
+  [GColorSpringBudARGB8] = GColorDarkGreenARGB8,
+  [GColorInchwormARGB8] = GColorMidnightGreenARGB8,
+  [GColorMintGreenARGB8] = GColorDarkGreenARGB8,
+  [GColorCelesteARGB8] = GColorOxfordBlueARGB8,
+  [GColorRedARGB8] = GColorSunsetOrangeARGB8,
+  [GColorFollyARGB8] = GColorMelonARGB8,
+  [GColorFashionMagentaARGB8] = GColorMagentaARGB8,
+  [GColorMagentaARGB8] = GColorFashionMagentaARGB8,
+  [GColorOrangeARGB8] = GColorRajahARGB8,
+  [GColorSunsetOrangeARGB8] = GColorRedARGB8,
+  [GColorBrilliantRoseARGB8] = GColorJazzberryJamARGB8,
+  [GColorShockingPinkARGB8] = GColorPurpleARGB8,
+  [GColorChromeYellowARGB8] = GColorWindsorTanARGB8,
+  [GColorRajahARGB8] = GColorOrangeARGB8,
+  [GColorMelonARGB8] = GColorDarkCandyAppleRedARGB8,
+  [GColorRichBrilliantLavenderARGB8] = GColorImperialPurpleARGB8,
+  [GColorYellowARGB8] = GColorChromeYellowARGB8,
+  [GColorIcterineARGB8] = GColorChromeYellowARGB8,
+  [GColorPastelYellowARGB8] = GColorChromeYellowARGB8,
+  [GColorWhiteARGB8] = GColorWhiteARGB8
+};
+
+// palette map effect - replaces every pixel with its entry in the 256-entry map passed as param
+void effect_palette_map(GContext* ctx,  GRect position, void* param) {
+#ifdef PBL_COLOR // palette of Aplite framebuffer is just black and white
+  effect_apply_color_map(ctx, position, (const uint8_t *)param);
+#endif
+}
+
+// invert brightness of colors (leaves hue more or less intact and does not apply to black and white).
+void effect_invert_brightness(GContext* ctx,  GRect position, void* param) {
+  effect_palette_map(ctx, position, (void *)effect_invert_brightness_map);
+}
+
+// per-pixel color function of a color-mapping effect (identical to what the effect does to a single pixel)
+// returns false if effect is not a pure color mapping
+static bool map_color(effect_cb *effect, void *param, uint8_t *color) {
+#ifdef PBL_COLOR
+  GColor pixel = (GColor)*color;
+  if (effect == effect_invert) {
+    *color = ~*color | 0xC0;
+  } else if (effect == effect_invert_bw_only) {
+    if (gcolor_equal(pixel, GColorBlack)) *color = GColorWhite.argb;
+    else if (gcolor_equal(pixel, GColorWhite)) *color = GColorBlack.argb;
+  } else if (effect == effect_invert_brightness) {
+    *color = effect_invert_brightness_map[*color];
+  } else if (effect == effect_palette_map) {
+    *color = ((const uint8_t *)param)[*color];
+  } else if (effect == effect_colorize) {
+    if (gcolor_equal(pixel, ((EffectColorpair *)param)->firstColor)) *color = ((EffectColorpair *)param)->secondColor.argb;
+  } else if (effect == effect_colorswap) {
+    if (gcolor_equal(pixel, ((EffectColorpair *)param)->firstColor)) *color = ((EffectColorpair *)param)->secondColor.argb;
+    else if (gcolor_equal(pixel, ((EffectColorpair *)param)->secondColor)) *color = ((EffectColorpair *)param)->firstColor.argb;
+  } else {
+    return false;
+  }
+#else // on Aplite pixels are 0 or 1: both inverts flip them, the rest of color effects do nothing
+  if (effect == effect_invert || effect == effect_invert_bw_only) {
+    *color = 1 - *color;
+  } else if (effect != effect_invert_brightness && effect != effect_palette_map && effect != effect_colorize && effect != effect_colorswap) {
+    return false;
+  }
+#endif
+  return true;
+}
+
+// effects drawing through the graphics context (graphics_* calls) besides the framebuffer they capture - they can't
+// run inside a batch or the compositor. An effect that starts drawing has to be added here.
+static effect_cb *const s_drawing_effects[] = { effect_mask, effect_fps };
+
+bool effect_draws(effect_cb *effect) {
+  for (size_t i = 0; i < sizeof(s_drawing_effects) / sizeof(s_drawing_effects[0]); i++)
+    if (effect == s_drawing_effects[i]) return true;
+  return false;
+}
+
+// composes color mapping of the effect into the map (map[c] becomes effect applied to map[c])
+bool effect_compose_color_map(effect_cb *effect, void *param, uint8_t *map) {
+  uint8_t color = 0;
+  if (!map_color(effect, param, &color)) return false;
+  
+  if (map) for (int c = 0; c < 256; c++) map_color(effect, param, &map[c]);
+  return true;
+}
+
+// replaces every pixel of position with its map entry
+static void map_area(EffectRowIterator *rows, const uint8_t *map) {
+  while (effect_row_iterator_next(rows))
+    for (int x = rows->x_start; x <= rows->x_end; x++) row_set_pixel(rows->row, x, map[row_get_pixel(rows->row, x)]);
+}
+
+// applies color map to the pixels in position in a single framebuffer pass
+void effect_apply_color_map(GContext* ctx, GRect position, const uint8_t *map) {
   //capturing framebuffer bitmap
-  GBitmap *fb = graphics_capture_frame_buffer(ctx);
+  GBitmap *fb = effect_capture_frame_buffer(ctx);
   
   BitmapInfo bitmap_info;
   bitmap_info.bitmap = fb;
@@ -222,338 +750,738 @@ void effect_colorize(GContext* ctx,  GRect position, void* param) {
   bitmap_info.bytes_per_row = gbitmap_get_bytes_per_row(fb);
   bitmap_info.bitmap_format = gbitmap_get_format(fb);
   
-  EffectColorpair *paint = (EffectColorpair *)param;
+  bool one_bit = FB_1BIT;
+  if (one_bit && map[0] == 0 && map[1] == 1) { // 1bit identity - nothing to do
+    effect_release_frame_buffer(ctx, fb);
+    return;
+  }
+  
+  EffectRowIterator rows;
+  effect_row_iterator_init(&rows, bitmap_info, position);
+  
+  if (one_bit && map[0] == 1 && map[1] == 0) { // 1bit invert - flipping whole bytes/words
+    while (effect_row_iterator_next(&rows)) invert_row_1bit(rows.row, rows.x_start, rows.x_end);
+  } else if (one_bit) { // 1bit map to a single color - filling whole bytes
+    while (effect_row_iterator_next(&rows)) fill_row_1bit(rows.row, rows.x_start, rows.x_end, map[0]);
+  } else {
+    map_area(&rows, map);
+  }
+  
+  effect_release_frame_buffer(ctx, fb);
+}
 
-  for (int y = 0; y < position.size.h; y++){
-     for (int x = 0; x < position.size.w; x++){
-        if (gcolor_equal((GColor)get_pixel(bitmap_info, y + position.origin.y, x + position.origin.x), paint->firstColor)){
-           set_pixel(bitmap_info, y + position.origin.y, x + position.origin.x, (uint8_t)paint->secondColor.argb);
-        }
-     }
-  graphics_release_frame_buffer(ctx, fb);
+//  ********* Geometric transforms: mirrors and rotation going by whole rows and tiles ********* {
+
+// swaps "count" bytes between a and b, a 32-bit word at a time
+static void swap_bytes(uint8_t *a, uint8_t *b, int count) {
+  uint32_t temp_a, temp_b;
+  for (; count >= 4; count -= 4, a += 4, b += 4) {
+    memcpy(&temp_a, a, 4); memcpy(&temp_b, b, 4);
+    memcpy(a, &temp_b, 4); memcpy(b, &temp_a, 4);
+  }
+  for (; count > 0; count--, a++, b++) {
+    uint8_t temp = *a; *a = *b; *b = temp;
+  }
+}
+
+// swaps bits selected by mask between bytes a and b
+static inline void swap_masked(uint8_t *a, uint8_t *b, uint8_t mask) {
+  uint8_t diff = (*a ^ *b) & mask;
+  *a ^= diff; *b ^= diff;
+}
+
+// swaps 1bit pixels x_start..x_end (inclusive) between rows a and b
+static void swap_bits(uint8_t *a, uint8_t *b, int x_start, int x_end) {
+  int first_byte = x_start / 8;
+  int last_byte = x_end / 8;
+  uint8_t first_mask = 0xFF << (x_start % 8);
+  uint8_t last_mask = 0xFF >> (7 - x_end % 8);
+  
+  if (first_byte == last_byte) {
+    swap_masked(a + first_byte, b + first_byte, first_mask & last_mask);
+    return;
+  }
+  swap_masked(a + first_byte, b + first_byte, first_mask);
+  swap_masked(a + last_byte, b + last_byte, last_mask);
+  swap_bytes(a + first_byte + 1, b + first_byte + 1, last_byte - first_byte - 1);
+}
+
+// reverses order of bytes left..right (inclusive), 4 bytes from each end at a time
+static void reverse_bytes(uint8_t *left, uint8_t *right) {
+  uint32_t temp_left, temp_right;
+  for (; right - left >= 7; left += 4, right -= 4) {
+    memcpy(&temp_left, left, 4); memcpy(&temp_right, right - 3, 4);
+    temp_left = __builtin_bswap32(temp_left); temp_right = __builtin_bswap32(temp_right);
+    memcpy(left, &temp_right, 4); memcpy(right - 3, &temp_left, 4);
   }
+  for (; left < right; left++, right--) {
+    uint8_t temp = *left; *left = *right; *right = temp;
+  }
+}
+
+static inline uint8_t reverse_bits(uint8_t value) {
+  static const uint8_t nibble[16] = {0x0, 0x8, 0x4, 0xC, 0x2, 0xA, 0x6, 0xE, 0x1, 0x9, 0x5, 0xD, 0x3, 0xB, 0x7, 0xF};
+  return nibble[value & 0xF] << 4 | nibble[value >> 4];
+}
+
+#define MAX_ROW_BYTES 32 // enough for 1bit rows up to 256 pixels wide
+
+// reverses order of 1bit pixels x_start..x_end (inclusive) of the row, a byte at a time:
+// the span is shifted to a byte boundary, bytes are reversed along with their bits and the result shifted back
+static void reverse_row_1bit(uint8_t *row, int x_start, int x_end) {
+  uint8_t span[MAX_ROW_BYTES], reversed[MAX_ROW_BYTES];
+  int count = x_end - x_start + 1;
+  int bytes = (count + 7) / 8;
+  int first_byte = x_start / 8, last_byte = x_end / 8;
+  int shift = x_start % 8, pad = bytes * 8 - count;
+  
+  // span[i] holds pixels x_start + 8i ... x_start + 8i + 7
+  for (int i = 0; i < bytes; i++) {
+    span[i] = row[first_byte + i] >> shift;
+    if (shift && first_byte + i + 1 <= last_byte) span[i] |= row[first_byte + i + 1] << (8 - shift);
+  }
+  
+  // reversed padded span, the padding ends up in the first "pad" bits and is dropped
+  for (int i = 0; i < bytes; i++) reversed[i] = reverse_bits(span[bytes - 1 - i]);
+  for (int i = 0; i < bytes; i++) {
+    span[i] = reversed[i] >> pad;
+    if (pad && i + 1 < bytes) span[i] |= reversed[i + 1] << (8 - pad);
+  }
+  
+  // shifting back in place, edge bytes keep pixels outside of the span
+  for (int k = 0; k <= last_byte - first_byte; k++) {
+    uint8_t value = k < bytes ? span[k] << shift : 0;
+    if (shift && k > 0) value |= span[k - 1] >> (8 - shift);
+    
+    uint8_t mask = 0xFF;
+    if (k == 0) mask &= 0xFF << shift;
+    if (k == last_byte - first_byte) mask &= 0xFF >> (7 - x_end % 8);
+    row[first_byte + k] = (row[first_byte + k] & ~mask) | (value & mask);
+  }
+}
+
+// Rotation tiles: tile of quadrant q covers c1 = c1_start.., c2 = c2_start.. around the center, where quadrant q is
+// quadrant 0 (y = +c1, x = +c2) turned q quarters counterclockwise. In quadrants 1 and 3 (y = -c2 / +c2, x = +c1 / -c1)
+// framebuffer rows of the tile run along c1, in quadrants 0 and 2 along c2. Pixels outside of the screen read as white.
+#ifdef PBL_COLOR
+#define ROTATE_TILE 16
+typedef struct { uint8_t pixels[ROTATE_TILE][ROTATE_TILE]; } RotateTile; // indexed [c1 - c1_start][c2 - c2_start]
+
+// copies tile of quadrant q from the framebuffer into "tile" (or from "tile" into the framebuffer when "store" is set),
+// a framebuffer row at a time: only the part of the row inside of its span is copied, the rest reads as white
+static void rotate_tile_io(BitmapInfo bitmap_info, GRect fb_bounds, GPoint center, int q, int c1_start, int c1_count,
+                           int c2_start, int c2_count, RotateTile *tile, bool store) {
+  bool c2_along_y = q & 1;
+  int sign_y = (q == 0 || q == 3) ? 1 : -1;
+  int sign_x = (q == 0 || q == 1) ? 1 : -1;
+  int rows = c2_along_y ? c2_count : c1_count, columns = c2_along_y ? c1_count : c2_count;
+  int row_start = c2_along_y ? c2_start : c1_start, column_start = c2_along_y ? c1_start : c2_start;
+  int x0 = center.x + sign_x * column_start; // pixel v of a row is at x0 + sign_x * v
+  int stride = c2_along_y ? ROTATE_TILE : 1;  // tile step from pixel v to v + 1
+  
+  for (int u = 0; u < rows; u++) {
+    GBitmapDataRowInfo span;
+    get_screen_row(bitmap_info, fb_bounds, center.y + sign_y * (row_start + u), &span);
+    int v_start = sign_x > 0 ? span.min_x - x0 : x0 - span.max_x;
+    int v_end = sign_x > 0 ? span.max_x - x0 : x0 - span.min_x;
+    if (v_start < 0) v_start = 0;
+    if (v_end > columns - 1) v_end = columns - 1;
+    uint8_t *cell = c2_along_y ? &tile->pixels[0][u] : &tile->pixels[u][0];
+    
+    if (store) {
+      if (v_start > v_end) continue;
+      uint8_t *pixel = span.data + x0 + sign_x * v_start;
+      for (int v = v_start; v <= v_end; v++, pixel += sign_x) *pixel = cell[v * stride];
+    } else {
+      for (int v = 0; v < columns; v++) cell[v * stride] = GColorWhiteARGB8;
+      if (v_start > v_end) continue;
+      const uint8_t *pixel = span.data + x0 + sign_x * v_start;
+      for (int v = v_start; v <= v_end; v++, pixel += sign_x) cell[v * stride] = *pixel;
+    }
+  }
+}
+#else
+#define ROTATE_TILE 32
+typedef struct { uint32_t rows[ROTATE_TILE]; } RotateTile; // 32x32 bit matrix: word c1 - c1_start, bit c2 - c2_start
+
+// pixels of 1bit screen row within x..x+31 that are inside of its span, bit j for pixel x + j
+static inline uint32_t span_mask32(const GBitmapDataRowInfo *span, int x) {
+  int lo = span->min_x - x, hi = span->max_x - x;
+  if (lo > 31 || hi < 0 || lo > hi) return 0;
+  if (lo < 0) lo = 0;
+  if (hi > 31) hi = 31;
+  return (0xFFFFFFFF << lo) & (0xFFFFFFFF >> (31 - hi));
+}
+
+// pixels x..x+31 of 1bit screen row as a word (bit j is pixel x + j), pixels outside of the span read as white;
+// read as the two row words they straddle (1bit rows are whole words long)
+static uint32_t bits32_load(const GBitmapDataRowInfo *span, int x) {
+  uint32_t inside = span_mask32(span, x);
+  if (!inside) return 0xFFFFFFFF;
+  int w = floor_div(x, 32), shift = x - w * 32;
+  uint32_t low = 0, high = 0;
+  if (inside << shift) memcpy(&low, span->data + 4 * w, 4);
+  if (shift && inside >> (32 - shift)) memcpy(&high, span->data + 4 * (w + 1), 4);
+  uint32_t pixels = shift ? low >> shift | high << (32 - shift) : low;
+  return (pixels & inside) | ~inside;
+}
+
+// writes pixels of "value" marked in "mask" to x..x+31 of 1bit screen row (as read by bits32_load), within the span
+static void bits32_store(GBitmapDataRowInfo *span, int x, uint32_t value, uint32_t mask) {
+  mask &= span_mask32(span, x);
+  if (!mask) return;
+  int w = floor_div(x, 32), shift = x - w * 32;
+  uint32_t word;
+  if (mask << shift) {
+    memcpy(&word, span->data + 4 * w, 4);
+    word = (word & ~(mask << shift)) | ((value & mask) << shift);
+    memcpy(span->data + 4 * w, &word, 4);
+  }
+  if (shift && mask >> (32 - shift)) {
+    memcpy(&word, span->data + 4 * (w + 1), 4);
+    word = (word & ~(mask >> (32 - shift))) | ((value & mask) >> (32 - shift));
+    memcpy(span->data + 4 * (w + 1), &word, 4);
+  }
+}
+
+static inline uint32_t reverse_bits32(uint32_t value) {
+  value = (value >> 1 & 0x55555555) | (value & 0x55555555) << 1;
+  value = (value >> 2 & 0x33333333) | (value & 0x33333333) << 2;
+  value = (value >> 4 & 0x0F0F0F0F) | (value & 0x0F0F0F0F) << 4;
+  return __builtin_bswap32(value);
+}
+
+// transposes the top left n x n block (n a power of two up to 32) of bit matrix m (bit j of word i is element i, j)
+// in place: swaps off-diagonal halves of the block, then the quarters within them and so on down to single bits
+static void transpose_bits(uint32_t *m, int n) {
+  if (n < 2) return;
+  uint32_t mask = 0xFFFFFFFF >> (32 - n / 2);
+  for (int period = n; period < 32; period <<= 1) mask |= mask << period; // low n / 2 bits of every n
+  for (int j = n / 2; j != 0; j >>= 1, mask ^= mask << j)
+    for (int k = 0; k < n; k = (k + j + 1) & ~j) {
+      uint32_t t = ((m[k] >> j) ^ m[k + j]) & mask;
+      m[k + j] ^= t;
+      m[k] ^= t << j;
+    }
+}
+
+// copies tile of quadrant q from the framebuffer into "tile" (or from "tile" into the framebuffer when "store" is set):
+// every framebuffer row of the tile is a word, turned into the tile's orientation by reversing its bits for rows
+// running towards lower x and by transposing the matrix in quadrants 1 and 3
+static void rotate_tile_io(BitmapInfo bitmap_info, GRect fb_bounds, GPoint center, int q, int c1_start, int c1_count,
+                           int c2_start, int c2_count, RotateTile *tile, bool store) {
+  bool c2_along_y = q & 1;
+  int sign_y = (q == 0 || q == 3) ? 1 : -1;
+  int sign_x = (q == 0 || q == 1) ? 1 : -1;
+  int rows = c2_along_y ? c2_count : c1_count, columns = c2_along_y ? c1_count : c2_count;
+  int row_start = c2_along_y ? c2_start : c1_start, column_start = c2_along_y ? c1_start : c2_start;
+  int x = sign_x > 0 ? center.x + column_start : center.x - column_start - 31; // first pixel of the row's word
+  uint32_t valid = 0xFFFFFFFF >> (32 - columns);
+  if (sign_x < 0) valid = reverse_bits32(valid);
+  
+  int n = 1; // transposed block
+  while (n < c1_count || n < c2_count) n <<= 1;
+  
+  RotateTile rotated;
+  if (store && c2_along_y) {
+    rotated = *tile;
+    transpose_bits(rotated.rows, n);
+    tile = &rotated;
+  }
+  for (int u = 0; u < rows; u++) {
+    GBitmapDataRowInfo span;
+    get_screen_row(bitmap_info, fb_bounds, center.y + sign_y * (row_start + u), &span);
+    if (store) {
+      bits32_store(&span, x, sign_x < 0 ? reverse_bits32(tile->rows[u]) : tile->rows[u], valid);
+    } else {
+      uint32_t value = bits32_load(&span, x);
+      tile->rows[u] = sign_x < 0 ? reverse_bits32(value) : value;
+    }
+  }
+  if (!store && c2_along_y) {
+    for (int u = rows; u < n; u++) tile->rows[u] = 0;
+    transpose_bits(tile->rows, n);
+  }
+}
 #endif
+
+#if defined(PBL_COLOR) && !defined(PBL_PLATFORM_CHALK)
+// rotates the square of half size qtr around center in place, cycling four pixels at a time; used when the square
+// lies entirely on the rectangular screen, so rows are found by offset and pixels need no visibility checks.
+// Pixel (y + c1, x + c2) gets (y - c2, x + c1) turning right, (y + c2, x - c1) turning left.
+static void rotate_square(uint8_t *data, int stride, GPoint center, int qtr, bool right) {
+  for (int c1 = 0; c1 < qtr; c1++) {
+    uint8_t *row0 = data + (center.y + c1) * stride, *row2 = data + (center.y - c1) * stride;
+    uint8_t *row1 = data + (center.y - 1) * stride, *row3 = data + (center.y + 1) * stride;
+    int x1 = center.x + c1, x3 = center.x - c1;
+    for (int c2 = 1; c2 < qtr; c2++, row1 -= stride, row3 += stride) {
+      int x0 = center.x + c2, x2 = center.x - c2;
+      uint8_t p0 = row_get_pixel(row0, x0), p1 = row_get_pixel(row1, x1), p2 = row_get_pixel(row2, x2), p3 = row_get_pixel(row3, x3);
+      if (right) {
+        row_set_pixel(row0, x0, p1); row_set_pixel(row1, x1, p2); row_set_pixel(row2, x2, p3); row_set_pixel(row3, x3, p0);
+      } else {
+        row_set_pixel(row0, x0, p3); row_set_pixel(row3, x3, p2); row_set_pixel(row2, x2, p1); row_set_pixel(row1, x1, p0);
+      }
+    }
+  }
 }
+#endif
 
+//  ********* Geometric transforms ********* }
 
-// colorswap effect - swaps two colors in a given area
-// Added by Martin Norland (@cynorg)
-// Parameter:  GColor firstColor, GColor secondColor
-void effect_colorswap(GContext* ctx,  GRect position, void* param) {
-#ifdef PBL_COLOR // only logical to do anything on Basalt - otherwise you're just ... doing an invert
+
+// vertical mirror effect.
+// Rows are swapped as a whole, a word at a time.
+void effect_mirror_vertical(GContext* ctx, GRect position, void* param) {
   //capturing framebuffer bitmap
-  GBitmap *fb = graphics_capture_frame_buffer(ctx);
- 
+  GBitmap *fb = effect_capture_frame_buffer(ctx);
+  
   BitmapInfo bitmap_info;
   bitmap_info.bitmap = fb;
   bitmap_info.bitmap_data =  gbitmap_get_data(fb);
   bitmap_info.bytes_per_row = gbitmap_get_bytes_per_row(fb);
   bitmap_info.bitmap_format = gbitmap_get_format(fb);
   
-  EffectColorpair *swap = (EffectColorpair *)param;
-  GColor pixel;
+  bool one_bit = FB_1BIT;
+  GRect area = clip_rect(position, gbitmap_get_bounds(fb));
+  GBitmapDataRowInfo top, bottom;
+  int mirror_sum = 2 * position.origin.y + position.size.h - 1; // row y is swapped with row mirror_sum - y
 
-  for (int y = 0; y < position.size.h; y++){
-     for (int x = 0; x < position.size.w; x++){
-          pixel.argb = get_pixel(bitmap_info, y + position.origin.y, x + position.origin.x);
-          if (gcolor_equal(pixel, swap->firstColor))
-            set_pixel(bitmap_info, y + position.origin.y, x + position.origin.x, swap->secondColor.argb);
-          else if (gcolor_equal(pixel, swap->secondColor))
-            set_pixel(bitmap_info, y + position.origin.y, x + position.origin.x, swap->firstColor.argb);
-     }
-  graphics_release_frame_buffer(ctx, fb);
+  for (int y = area.origin.y; 2 * y < mirror_sum; y++) {
+    // rows whose mirror is off screen stay as they are
+    if (mirror_sum - y > area.origin.y + area.size.h - 1) continue;
+    if (!get_row_span(bitmap_info, y, area, &top) || !get_row_span(bitmap_info, mirror_sum - y, area, &bottom)) continue;
+    
+    // on round screen only the part visible in both rows is swapped
+    int min_x = top.min_x > bottom.min_x ? top.min_x : bottom.min_x;
+    int max_x = top.max_x < bottom.max_x ? top.max_x : bottom.max_x;
+    if (min_x > max_x) continue;
+    
+    if (one_bit)
+      swap_bits(top.data, bottom.data, min_x, max_x);
+    else
+      swap_bytes(top.data + min_x, bottom.data + min_x, max_x - min_x + 1);
   }
-#endif
+  
+  effect_release_frame_buffer(ctx, fb);
 }
 
-// invert black and white only (leaves all other colors intact).
-void effect_invert_bw_only(GContext* ctx,  GRect position, void* param) {
+
+// horizontal mirror effect.
+// Every row is reversed in place, 4 pixels at a time (a byte at a time on 1bit framebuffer).
+void effect_mirror_horizontal(GContext* ctx, GRect position, void* param) {
+  //capturing framebuffer bitmap
+  GBitmap *fb = effect_capture_frame_buffer(ctx);
+  
+  BitmapInfo bitmap_info;
+  bitmap_info.bitmap = fb;
+  bitmap_info.bitmap_data =  gbitmap_get_data(fb);
+  bitmap_info.bytes_per_row = gbitmap_get_bytes_per_row(fb);
+  bitmap_info.bitmap_format = gbitmap_get_format(fb);
+
+  bool one_bit = FB_1BIT;
+  EffectRowIterator rows;
+  effect_row_iterator_init(&rows, bitmap_info, position);
+
+  int mirror_sum = 2 * position.origin.x + position.size.w - 1; // pixel x is swapped with pixel mirror_sum - x
+
+  while (effect_row_iterator_next(&rows)) {
+    // only pixels whose mirror is visible too are swapped
+    int min_x = rows.x_start, max_x = rows.x_end;
+    if (min_x < mirror_sum - max_x) min_x = mirror_sum - max_x;
+    else max_x = mirror_sum - min_x;
+    if (min_x >= max_x) continue;
+    
+    if (one_bit)
+      reverse_row_1bit(rows.row, min_x, max_x);
+    else
+      reverse_bytes(rows.row + min_x, rows.row + max_x);
+  }
+  
+  effect_release_frame_buffer(ctx, fb);
+}
+
+// Rotate 90 degrees
+// Added by Ron64
+// Parameter:  true: rotate right/clockwise,  false: rotate left/counter_clockwise
+// On Basalt a square entirely on the screen is rotated in place by rotate_square; otherwise it is rotated tile by
+// tile: the four tiles a tile moves through are read row by row, cycled and written back (on Aplite a tile row is
+// a word of pixels and tiles are turned by bit matrix transposes).
+void effect_rotate_90_degrees(GContext* ctx,  GRect position, void* param){
+
   //capturing framebuffer bitmap
-  GBitmap *fb = graphics_capture_frame_buffer(ctx);
+  GBitmap *fb = effect_capture_frame_buffer(ctx);
   
   BitmapInfo bitmap_info;
   bitmap_info.bitmap = fb;
   bitmap_info.bitmap_data =  gbitmap_get_data(fb);
   bitmap_info.bytes_per_row = gbitmap_get_bytes_per_row(fb);
   bitmap_info.bitmap_format = gbitmap_get_format(fb);
+  GRect fb_bounds = gbitmap_get_bounds(fb);
+  
+  bool right = (bool)param;
+  int qtr;
+  GPoint center = GPoint(position.origin.x + position.size.w /2, position.origin.y + position.size.h /2);
+  qtr=position.size.w;
+  if (position.size.h < qtr)
+    qtr= position.size.h;
+  qtr= qtr/2;
+
+#if defined(PBL_COLOR) && !defined(PBL_PLATFORM_CHALK)
+  if (qtr > 0 && center.x - qtr + 1 >= 0 && center.x + qtr - 1 < fb_bounds.size.w &&
+      center.y - qtr + 1 >= 0 && center.y + qtr - 1 < fb_bounds.size.h) {
+    rotate_square(bitmap_info.bitmap_data, bitmap_info.bytes_per_row, center, qtr, right);
+    effect_release_frame_buffer(ctx, fb);
+    return;
+  }
+#endif
+  
+  RotateTile *tiles = effect_scratch_alloc(sizeof(RotateTile) * 4);
+  if (!tiles) {
+    effect_release_frame_buffer(ctx, fb);
+    return;
+  }
+  
+  for (int c1 = 0; c1 < qtr; c1 += ROTATE_TILE)
+    for (int c2 = 1; c2 < qtr; c2 += ROTATE_TILE) {
+      int c1_count = qtr - c1 < ROTATE_TILE ? qtr - c1 : ROTATE_TILE;
+      int c2_count = qtr - c2 < ROTATE_TILE ? qtr - c2 : ROTATE_TILE;
+      
+      for (int q = 0; q < 4; q++)
+        rotate_tile_io(bitmap_info, fb_bounds, center, q, c1, c1_count, c2, c2_count, &tiles[q], false);
+      
+      // turning right every quadrant gets the one after it (counterclockwise), turning left the one before
+      for (int q = 0; q < 4; q++)
+        rotate_tile_io(bitmap_info, fb_bounds, center, q, c1, c1_count, c2, c2_count, &tiles[(q + (right ? 1 : 3)) % 4], true);
+    }
+  
+  effect_scratch_free(tiles);
+  effect_release_frame_buffer(ctx, fb);
+}
+
+// source index maps of zoom effect, rebuilt only when zoom or effect area change
+typedef struct {
+  EffectCache cache;
+  int32_t param;
+  GRect position;
+  int16_t *maps; // source column of every column of the area, followed by source row of every row
+} ZoomCache;
+
+static EffectCache *s_zoom_direct;
+
+static void zoom_cache_destroy(EffectCache *cache) {
+  free(((ZoomCache *)cache)->maps);
+  free(cache);
+}
+
+// maps "count" coordinates from "start" to the source ones zoomed by ratio/16 around "center", clamped to the area
+static void build_zoom_map(int16_t *map, int start, int count, int center, uint8_t ratio) {
+  for (int i = 0; i < count; i++) {
+    int d = start + i - center;
+    int s = center + (d >= 0 ? (d << 4) / ratio : -((-d << 4) / ratio));
+    map[i] = s < start ? start : s > start + count - 1 ? start + count - 1 : s;
+  }
+}
+
+// returns zoom maps for given parameter and effect area (clipped to the screen), building them if needed
+static int16_t* get_zoom_maps(int32_t param, GRect position, GRect area) {
+  ZoomCache *zoom = (ZoomCache *)get_cache(&s_zoom_direct, zoom_cache_destroy, sizeof(ZoomCache));
+  if (!zoom) return NULL;
+  if (zoom->maps && zoom->param == param && grect_equal(&zoom->position, &position))
+    return zoom->maps;
+  
+  free(zoom->maps);
+  zoom->maps = malloc(sizeof(int16_t) * (area.size.w + area.size.h));
+  if (!zoom->maps) return NULL;
+  
+  zoom->param = param;
+  zoom->position = position;
+  build_zoom_map(zoom->maps, area.origin.x, area.size.w, position.origin.x + position.size.w / 2, param & 0xFF);
+  build_zoom_map(zoom->maps + area.size.w, area.origin.y, area.size.h, position.origin.y + position.size.h / 2, param >> 8 & 0xFF);
+  
+  return zoom->maps;
+}
+
+// gathers row "sy" zoomed through the column map into "zoomed": pixel of the area at x goes to x - area.origin.x
+// (on 1bit to bit x - area.origin.x / 8 * 8, whole bytes are written). Returns false if the row is not in the area.
+static bool zoom_gather(BitmapInfo bitmap_info, GRect area, int sy, const int16_t *cols, uint8_t *zoomed) {
+  GBitmapDataRowInfo source;
+  if (!get_row_span(bitmap_info, sy, area, &source)) return false;
+  
+  if (FB_1BIT) {
+    int shift = area.origin.x % 8;
+    uint8_t byte = 0;
+    for (int i = 0; i < area.size.w; i++) {
+      byte |= row_get_pixel(source.data, cols[i]) << ((shift + i) % 8);
+      if ((shift + i) % 8 == 7) {
+        *zoomed++ = byte;
+        byte = 0;
+      }
+    }
+    if ((shift + area.size.w) % 8) *zoomed = byte;
+  } else {
+    for (int i = 0; i < area.size.w; i++) {
+      int sx = cols[i];
+      if (sx < source.min_x) sx = source.min_x; // on round screen source row may be shorter
+      if (sx > source.max_x) sx = source.max_x;
+      zoomed[i] = row_get_pixel(source.data, sx);
+    }
+  }
+  return true;
+}
+
+// writes row y of the area from a row gathered by zoom_gather
+static void zoom_put(BitmapInfo bitmap_info, GRect area, int y, const uint8_t *zoomed) {
+  GBitmapDataRowInfo dest;
+  if (!get_row_span(bitmap_info, y, area, &dest)) return;
+  
+  if (FB_1BIT) {
+    int first = dest.min_x / 8, last = dest.max_x / 8;
+    uint8_t first_mask = 0xFF << (dest.min_x % 8), last_mask = 0xFF >> (7 - dest.max_x % 8);
+    zoomed -= area.origin.x / 8; // indexed by framebuffer byte from here
+    if (first == last) {
+      first_mask &= last_mask;
+      dest.data[first] = (dest.data[first] & ~first_mask) | (zoomed[first] & first_mask);
+      return;
+    }
+    dest.data[first] = (dest.data[first] & ~first_mask) | (zoomed[first] & first_mask);
+    memcpy(dest.data + first + 1, zoomed + first + 1, last - first - 1);
+    dest.data[last] = (dest.data[last] & ~last_mask) | (zoomed[last] & last_mask);
+  } else {
+    memcpy(dest.data + dest.min_x, zoomed + dest.min_x - area.origin.x, dest.max_x - dest.min_x + 1);
+  }
+}
 
-#ifdef PBL_COLOR
-  GColor pixel;
-#endif
-  
-  for (int y = 0; y < position.size.h; y++) {
-     for (int x = 0; x < position.size.w; x++) {
-        #ifdef PBL_COLOR // on Basalt invert only black or white
-          pixel.argb = get_pixel(bitmap_info, y + position.origin.y, x + position.origin.x);
-          if (gcolor_equal(pixel, GColorBlack))
-            set_pixel(bitmap_info, y + position.origin.y, x + position.origin.x, GColorWhite.argb);
-          else if (gcolor_equal(pixel, GColorWhite))
-            set_pixel(bitmap_info, y + position.origin.y, x + position.origin.x, GColorBlack.argb);
-        #else // on Aplite since only 1 and 0 is returning, doing "not" by 1 - pixel
-          set_pixel(bitmap_info, y + position.origin.y, x + position.origin.x, 1 - get_pixel(bitmap_info, y + position.origin.y, x + position.origin.x));
-        #endif
-     }
+// writes zoomed row y: rows zoomed from the source row gathered last ("gathered", -1 for none) only copy it
+static void zoom_row(BitmapInfo bitmap_info, GRect area, int y, const int16_t *cols, const int16_t *rows,
+                     uint8_t *zoomed, int *gathered) {
+  int sy = rows[y - area.origin.y];
+  if (sy != *gathered) {
+    if (!zoom_gather(bitmap_info, area, sy, cols, zoomed)) return;
+    *gathered = sy;
   }
- 
-  graphics_release_frame_buffer(ctx, fb);          
-          
+  zoom_put(bitmap_info, area, y, zoomed);
 }
 
-// invert brightness of colors (leaves hue more or less intact and does not apply to black and white).
-void effect_invert_brightness(GContext* ctx,  GRect position, void* param) {
-#ifdef PBL_COLOR
-  //capturing framebuffer bitmap
-  GBitmap *fb = graphics_capture_frame_buffer(ctx);
- 
+// Zoom effect.
+// Added by Ron64
+// Parameter: Y zoom (high byte) X zoom(low byte),  0x10 no zoom 0x20 200% 0x08 50%, 
+// use the percentage macro EL_ZOOM(150,60). In this example: Y- zoom in 150%, X- zoom out to 60% 
+// Source coordinates come from maps built once per zoom, source is clamped to the effect area. Every source row
+// is gathered once, rows repeating it (zooming in) are copied whole.
+// Rows are written in the order that never overwrites a row still needed as source: from edges to center
+// when zooming in, from center to edges when zooming out.
+void effect_zoom(GContext* ctx,  GRect position, void* param){
+  GBitmap *fb = effect_capture_frame_buffer(ctx);
+  
   BitmapInfo bitmap_info;
   bitmap_info.bitmap = fb;
   bitmap_info.bitmap_data =  gbitmap_get_data(fb);
   bitmap_info.bytes_per_row = gbitmap_get_bytes_per_row(fb);
   bitmap_info.bitmap_format = gbitmap_get_format(fb);
 
-  GColor pixel;
-  GColor pixel_new;
+  uint8_t ratioY = (int32_t)param >>8 & 0xFF;
+  uint8_t ratioX = (int32_t)param & 0xFF;
+  GRect area = clip_rect(position, gbitmap_get_bounds(fb));
   
-  for (int y = 0; y < position.size.h; y++) {
-     for (int x = 0; x < position.size.w; x++) {
-         pixel.argb = get_pixel(bitmap_info, y + position.origin.y, x + position.origin.x);
-         
-         if (!gcolor_equal(pixel, GColorBlack) && !gcolor_equal(pixel, GColorWhite)) {
-           // Only apply if not black/white (add effect_invert_bw_only for that too)
-           
-           // Color spread is not even, so need to handcraft the opposing brightness of colors,
-           // which is probably subjective and open for improvement
-           if (gcolor_equal(pixel, GColorOxfordBlue))
-             pixel_new = GColorCeleste;
-           else if (gcolor_equal(pixel, GColorDukeBlue))
-             pixel_new = GColorVividCerulean;
-           else if (gcolor_equal(pixel, GColorBlue))
-             pixel_new = GColorPictonBlue;
-           else if (gcolor_equal(pixel, GColorDarkGreen))
-             pixel_new = GColorMintGreen;
-           else if (gcolor_equal(pixel, GColorMidnightGreen))
-             pixel_new = GColorMediumSpringGreen;
-           else if (gcolor_equal(pixel, GColorCobaltBlue))
-             pixel_new = GColorCyan;
-           else if (gcolor_equal(pixel, GColorBlueMoon))
-             pixel_new = GColorElectricBlue;
-           else if (gcolor_equal(pixel, GColorIslamicGreen))
-             pixel_new = GColorMalachite;
-           else if (gcolor_equal(pixel, GColorJaegerGreen))
-             pixel_new = GColorScreaminGreen;
-           else if (gcolor_equal(pixel, GColorTiffanyBlue))
-             pixel_new = GColorCadetBlue;
-           else if (gcolor_equal(pixel, GColorVividCerulean))
-             pixel_new = GColorDukeBlue;
-           else if (gcolor_equal(pixel, GColorGreen))
-             pixel_new = GColorMayGreen;
-           else if (gcolor_equal(pixel, GColorMalachite))
-             pixel_new = GColorIslamicGreen;
-           else if (gcolor_equal(pixel, GColorMediumSpringGreen))
-             pixel_new = GColorMidnightGreen;
-           else if (gcolor_equal(pixel, GColorCyan))
-             pixel_new = GColorCobaltBlue;
-           else if (gcolor_equal(pixel, GColorBulgarianRose))
-             pixel_new = GColorMelon;
-           else if (gcolor_equal(pixel, GColorImperialPurple))
-             pixel_new = GColorRichBrilliantLavender;
-           else if (gcolor_equal(pixel, GColorIndigo))
-             pixel_new = GColorLavenderIndigo;
-           else if (gcolor_equal(pixel, GColorElectricUltramarine))
-             pixel_new = GColorVeryLightBlue;
-           else if (gcolor_equal(pixel, GColorArmyGreen))
-             pixel_new = GColorBrass;
-           else if (gcolor_equal(pixel, GColorDarkGray))
-             pixel_new = GColorLightGray;
-           else if (gcolor_equal(pixel, GColorLiberty))
-             pixel_new = GColorBabyBlueEyes;
-           else if (gcolor_equal(pixel, GColorVeryLightBlue))
-             pixel_new = GColorElectricUltramarine;
-           else if (gcolor_equal(pixel, GColorKellyGreen))
-             pixel_new = GColorGreen;
-           else if (gcolor_equal(pixel, GColorMayGreen))
-             pixel_new = GColorMediumAquamarine;
-           else if (gcolor_equal(pixel, GColorCadetBlue))
-             pixel_new = GColorTiffanyBlue;
-           else if (gcolor_equal(pixel, GColorPictonBlue))
-             pixel_new = GColorBlue;
-           else if (gcolor_equal(pixel, GColorBrightGreen))
-             pixel_new = GColorIslamicGreen;
-           else if (gcolor_equal(pixel, GColorScreaminGreen))
-             pixel_new = GColorKellyGreen;
-           else if (gcolor_equal(pixel, GColorMediumAquamarine))
-             pixel_new = GColorMayGreen;
-           else if (gcolor_equal(pixel, GColorElectricBlue))
-             pixel_new = GColorBlueMoon;
-           else if (gcolor_equal(pixel, GColorDarkCandyAppleRed))
-             pixel_new = GColorMelon;
-           else if (gcolor_equal(pixel, GColorJazzberryJam))
-             pixel_new = GColorBrilliantRose;
-           else if (gcolor_equal(pixel, GColorPurple))
-             pixel_new = GColorShockingPink;
-           else if (gcolor_equal(pixel, GColorVividViolet))
-             pixel_new = GColorPurpureus;
-           else if (gcolor_equal(pixel, GColorWindsorTan))
-             pixel_new = GColorRoseVale;
-           else if (gcolor_equal(pixel, GColorRoseVale))
-             pixel_new = GColorWindsorTan;
-           else if (gcolor_equal(pixel, GColorPurpureus))
-             pixel_new = GColorVividViolet;
-           else if (gcolor_equal(pixel, GColorLavenderIndigo))
-             pixel_new = GColorIndigo;
-           else if (gcolor_equal(pixel, GColorLimerick))
-             pixel_new = GColorPastelYellow;
-           else if (gcolor_equal(pixel, GColorBrass))
-             pixel_new = GColorArmyGreen;
-           else if (gcolor_equal(pixel, GColorLightGray))
-             pixel_new = GColorDarkGray;
-           else if (gcolor_equal(pixel, GColorBabyBlueEyes))
-             pixel_new = GColorLiberty;
-           else if (gcolor_equal(pixel, GColorSpringBud))
-             pixel_new = GColorDarkGreen;
-           else if (gcolor_equal(pixel, GColorInchworm))
-             pixel_new = GColorMidnightGreen;
-           else if (gcolor_equal(pixel, GColorMintGreen))
-             pixel_new = GColorDarkGreen;
-           else if (gcolor_equal(pixel, GColorCeleste))
-             pixel_new = GColorOxfordBlue;
-           else if (gcolor_equal(pixel, GColorRed))
-             pixel_new = GColorSunsetOrange;
-           else if (gcolor_equal(pixel, GColorFolly))
-             pixel_new = GColorMelon;
-           else if (gcolor_equal(pixel, GColorFashionMagenta))
-             pixel_new = GColorMagenta ;
-           else if (gcolor_equal(pixel, GColorMagenta))
-             pixel_new = GColorFashionMagenta;
-           else if (gcolor_equal(pixel, GColorOrange))
-             pixel_new = GColorRajah;
-           else if (gcolor_equal(pixel, GColorSunsetOrange))
-             pixel_new = GColorRed;
-           else if (gcolor_equal(pixel, GColorBrilliantRose))
-             pixel_new = GColorJazzberryJam;
-           else if (gcolor_equal(pixel, GColorShockingPink))
-             pixel_new = GColorPurple;
-           else if (gcolor_equal(pixel, GColorChromeYellow))
-             pixel_new = GColorWindsorTan;
-           else if (gcolor_equal(pixel, GColorRajah))
-             pixel_new = GColorOrange;
-           else if (gcolor_equal(pixel, GColorMelon))
-             pixel_new = GColorDarkCandyAppleRed;
-           else if (gcolor_equal(pixel, GColorRichBrilliantLavender))
-             pixel_new = GColorImperialPurple;
-           else if (gcolor_equal(pixel, GColorYellow))
-             pixel_new = GColorChromeYellow;
-           else if (gcolor_equal(pixel, GColorIcterine))
-             pixel_new = GColorChromeYellow;
-           else if (gcolor_equal(pixel, GColorPastelYellow))
-             pixel_new = GColorChromeYellow;
-           
-           set_pixel(bitmap_info, y + position.origin.y, x + position.origin.x, pixel_new.argb);
-         }
-     }
+  if (ratioX == 0 || ratioY == 0 || area.size.w == 0 || area.size.h == 0 || (ratioX == 16 && ratioY == 16)) {
+    effect_release_frame_buffer(ctx, fb);
+    return;
   }
- 
-  graphics_release_frame_buffer(ctx, fb);          
-          
-#endif
-}
-
-// vertical mirror effect.
-void effect_mirror_vertical(GContext* ctx, GRect position, void* param) {
-  uint8_t temp_pixel;  
   
-  //capturing framebuffer bitmap
-  GBitmap *fb = graphics_capture_frame_buffer(ctx);
+  int16_t *maps = get_zoom_maps((int32_t)param, position, area);
+  uint8_t *zoomed = effect_scratch_alloc(area.size.w);
   
-  BitmapInfo bitmap_info;
-  bitmap_info.bitmap = fb;
-  bitmap_info.bitmap_data =  gbitmap_get_data(fb);
-  bitmap_info.bytes_per_row = gbitmap_get_bytes_per_row(fb);
-  bitmap_info.bitmap_format = gbitmap_get_format(fb);
-
-  for (int y = 0; y < position.size.h / 2 ; y++)
-     for (int x = 0; x < position.size.w; x++){
-        temp_pixel = get_pixel(bitmap_info, y + position.origin.y, x + position.origin.x);
-        set_pixel(bitmap_info, y + position.origin.y, x + position.origin.x, get_pixel(bitmap_info, position.origin.y + position.size.h - y - 2, x + position.origin.x));
-        set_pixel(bitmap_info, position.origin.y + position.size.h - y - 2, x + position.origin.x, temp_pixel);
-     }
+  if (maps && zoomed) {
+    int16_t *cols = maps, *rows = maps + area.size.w;
+    int top = area.origin.y, bottom = area.origin.y + area.size.h - 1;
+    int gathered = -1;
+    int yCn = position.origin.y + position.size.h /2;
+    int above = yCn - 1 < bottom ? yCn - 1 : bottom; // last row above center
+    int below = yCn + 1 > top ? yCn + 1 : top;       // first row below center
+    
+    if (ratioY > 16) { // zoom in - source rows are closer to center
+      for (int y = top; y <= above; y++) zoom_row(bitmap_info, area, y, cols, rows, zoomed, &gathered);
+      for (int y = bottom; y >= below; y--) zoom_row(bitmap_info, area, y, cols, rows, zoomed, &gathered);
+      if (yCn >= top && yCn <= bottom) zoom_row(bitmap_info, area, yCn, cols, rows, zoomed, &gathered);
+    } else { // zoom out (or horizontal zoom only) - source rows are further from center
+      if (yCn >= top && yCn <= bottom) zoom_row(bitmap_info, area, yCn, cols, rows, zoomed, &gathered);
+      for (int y = above; y >= top; y--) zoom_row(bitmap_info, area, y, cols, rows, zoomed, &gathered);
+      for (int y = below; y <= bottom; y++) zoom_row(bitmap_info, area, y, cols, rows, zoomed, &gathered);
+    }
+  }
   
-  graphics_release_frame_buffer(ctx, fb);
+  effect_scratch_free(zoomed);
+  effect_release_frame_buffer(ctx, fb);
 }
 
-
-// horizontal mirror effect.
-void effect_mirror_horizontal(GContext* ctx, GRect position, void* param) {
-  uint8_t temp_pixel;  
+// Affine transform effect
+// Every pixel of position is replaced by the pixel of the matrix-mapped source point. Source is read from a scratch
+// copy of the area, so already transformed pixels are never picked up again; mapping is stepped incrementally,
+// with only two additions per pixel after the start of each row.
+void effect_affine(GContext* ctx, GRect position, void* param) {
+  EffectAffine *affine = (EffectAffine *)param;
   
   //capturing framebuffer bitmap
-  GBitmap *fb = graphics_capture_frame_buffer(ctx);
+  GBitmap *fb = effect_capture_frame_buffer(ctx);
   
   BitmapInfo bitmap_info;
   bitmap_info.bitmap = fb;
   bitmap_info.bitmap_data =  gbitmap_get_data(fb);
   bitmap_info.bytes_per_row = gbitmap_get_bytes_per_row(fb);
   bitmap_info.bitmap_format = gbitmap_get_format(fb);
+  
+  bool one_bit = FB_1BIT;
+  uint8_t background = pixel_value(affine->background_color, one_bit);
+  GRect area = clip_rect(position, gbitmap_get_bounds(fb));
+  if (area.size.w == 0 || area.size.h == 0) {
+    effect_release_frame_buffer(ctx, fb);
+    return;
+  }
+  
+  // scratch copy keeps whole bytes on 1bit framebuffer, first_x is the first pixel of every copied row
+  int first_x = one_bit ? area.origin.x / 8 * 8 : area.origin.x;
+  int stride = one_bit ? (area.origin.x + area.size.w - 1) / 8 - area.origin.x / 8 + 1 : area.size.w;
+  uint8_t *scratch = effect_scratch_alloc(stride * area.size.h);
+  int16_t *visible = effect_scratch_alloc(sizeof(int16_t) * 2 * area.size.h); // visible min_x, max_x of every copied row
+  EffectRowIterator rows;
+  
+  if (scratch && visible) {
+    for (int r = 0; r < area.size.h; r++) {
+      visible[2*r] = 1; visible[2*r + 1] = 0; // rows skipped by the iterator have nothing visible
+    }
+    effect_row_iterator_init(&rows, bitmap_info, area);
+    while (effect_row_iterator_next(&rows)) {
+      int r = rows.y - area.origin.y;
+      visible[2*r] = rows.x_start; visible[2*r + 1] = rows.x_end;
+      if (one_bit)
+        memcpy(scratch + r*stride, rows.row + first_x / 8, stride);
+      else
+        memcpy(scratch + r*stride + rows.x_start - first_x, rows.row + rows.x_start, rows.x_end - rows.x_start + 1);
+    }
+    
+    int cx = position.origin.x + position.size.w / 2;
+    int cy = position.origin.y + position.size.h / 2;
+    
+    effect_row_iterator_init(&rows, bitmap_info, area);
+    while (effect_row_iterator_next(&rows)) {
+      // source point of the first pixel of the row, rounded to nearest by the 0.5 added
+      int32_t u = affine->a * (rows.x_start - cx) + affine->b * (rows.y - cy) + affine->tx + cx * 0x10000 + 0x8000;
+      int32_t v = affine->c * (rows.x_start - cx) + affine->d * (rows.y - cy) + affine->ty + cy * 0x10000 + 0x8000;
+      
+      for (int x = rows.x_start; x <= rows.x_end; x++, u += affine->a, v += affine->c) {
+        int sx = u >> 16, r = (v >> 16) - area.origin.y;
+        uint8_t pixel = background;
+        if (r >= 0 && r < area.size.h && sx >= visible[2*r] && sx <= visible[2*r + 1])
+          pixel = row_get_pixel(scratch + r*stride, sx - first_x);
+        row_set_pixel(rows.row, x, pixel);
+      }
+    }
+  }
+  
+  effect_scratch_free(visible);
+  effect_scratch_free(scratch);
+  effect_release_frame_buffer(ctx, fb);
+}
 
-  for (int y = 0; y < position.size.h; y++)
-     for (int x = 0; x < position.size.w / 2; x++){
-        temp_pixel = get_pixel(bitmap_info, y + position.origin.y, x + position.origin.x);
-        set_pixel(bitmap_info, y + position.origin.y, x + position.origin.x, get_pixel(bitmap_info, y + position.origin.y, position.origin.x + position.size.w - x - 2));
-        set_pixel(bitmap_info, y + position.origin.y, position.origin.x + position.size.w - x - 2, temp_pixel);
-     }
+// sets up affine transform turning the image by "angle" clockwise (TRIG_MAX_ANGLE is a full turn)
+// and zooming it by "scale" (16.16 fixed point, 0x10000 is 100%) around the center of the effect area
+void effect_affine_rotate_scale(EffectAffine *affine, int32_t angle, int32_t scale) {
+  if (scale < 1) scale = 1;
   
-  graphics_release_frame_buffer(ctx, fb);
+  // source is destination turned back and shrunk: cos / scale, sin / scale in 16.16 fixed point
+  int64_t divisor = (int64_t)TRIG_MAX_RATIO * scale;
+  int32_t cos_scaled = (int64_t)cos_lookup(angle) * 0x100000000LL / divisor;
+  int32_t sin_scaled = (int64_t)sin_lookup(angle) * 0x100000000LL / divisor;
+  
+  affine->a = cos_scaled;  affine->b = sin_scaled; affine->tx = 0;
+  affine->c = -sin_scaled; affine->d = cos_scaled; affine->ty = 0;
 }
 
-// Rotate 90 degrees
-// Added by Ron64
-// Parameter:  true: rotate right/clockwise,  false: rotate left/counter_clockwise
-void effect_rotate_90_degrees(GContext* ctx,  GRect position, void* param){
+// displacement table for lens effect, rebuilt only when focal, object distance or lens radius change
+typedef struct {
+  EffectCache cache;
+  uint8_t focal;
+  uint8_t obj_dis;
+  uint8_t r;
+  int16_t *offsets; // offsets[t] = tan(asin(t/focal))*obj_dis for t = 0..r
+} LensCache;
 
-  //capturing framebuffer bitmap
-  GBitmap *fb = graphics_capture_frame_buffer(ctx);
+static EffectCache *s_lens_direct;
+
+static void lens_cache_destroy(EffectCache *cache) {
+  free(((LensCache *)cache)->offsets);
+  free(cache);
+}
+
+// returns lens displacement table for given parameters, building it if needed (NULL if out of memory)
+static int16_t* get_lens_table(uint8_t focal, uint8_t obj_dis, uint8_t r) {
+  LensCache *lens = (LensCache *)get_cache(&s_lens_direct, lens_cache_destroy, sizeof(LensCache));
+  if (!lens) return NULL;
+  if (lens->offsets && lens->focal == focal && lens->obj_dis == obj_dis && lens->r == r)
+    return lens->offsets;
   
-  BitmapInfo bitmap_info;
-  bitmap_info.bitmap = fb;
-  bitmap_info.bitmap_data =  gbitmap_get_data(fb);
-  bitmap_info.bytes_per_row = gbitmap_get_bytes_per_row(fb);
-  bitmap_info.bitmap_format = gbitmap_get_format(fb);
+  free(lens->offsets);
+  lens->offsets = malloc(sizeof(int16_t) * (r + 1));
+  if (!lens->offsets) return NULL;
   
-  bool right = (bool)param;
-  uint8_t qtr, xCn, yCn, temp_pixel;
-  xCn= position.origin.x + position.size.w /2;
-  yCn= position.origin.y + position.size.h /2;
-  qtr=position.size.w;
-  if (position.size.h < qtr)
-    qtr= position.size.h;
-  qtr= qtr/2;
+  lens->focal = focal;
+  lens->obj_dis = obj_dis;
+  lens->r = r;
+  
+  // in fixed point, beyond the focal point (or with focal 0) asin saturates to 90 deg - displacement leaves the screen
+  for (int t = 0; t <= r; t++) {
+    int32_t tan = fx_tan(fx_asin(focal ? t * FX_ONE / focal : FX_ONE));
+    int64_t offset = (int64_t)tan * obj_dis / FX_ONE;
+    lens->offsets[t] = offset < INT16_MAX ? offset : INT16_MAX;
+  }
+  
+  return lens->offsets;
+}
 
-  for (int c1 = 0; c1 < qtr; c1++)
-    for (int c2 = 1; c2 < qtr; c2++){
-      temp_pixel = get_pixel(bitmap_info, yCn +c1, xCn +c2);
-      if (right){
-        set_pixel(bitmap_info, yCn +c1, xCn +c2, get_pixel(bitmap_info, yCn -c2, xCn +c1));
-        set_pixel(bitmap_info, yCn -c2, xCn +c1, get_pixel(bitmap_info, yCn -c1, xCn -c2));
-        set_pixel(bitmap_info, yCn -c1, xCn -c2, get_pixel(bitmap_info, yCn +c2, xCn -c1));
-        set_pixel(bitmap_info, yCn +c2, xCn -c1, temp_pixel);
-      }
-      else{
-        set_pixel(bitmap_info, yCn +c1, xCn +c2, get_pixel(bitmap_info, yCn +c2, xCn -c1));
-        set_pixel(bitmap_info, yCn +c2, xCn -c1, get_pixel(bitmap_info, yCn -c1, xCn -c2));
-        set_pixel(bitmap_info, yCn -c1, xCn -c2, get_pixel(bitmap_info, yCn -c2, xCn +c1));
-        set_pixel(bitmap_info, yCn -c2, xCn +c1, temp_pixel);
+// lens: every pixel within radius r of the center is replaced by the one at the displacement for its distance
+// from the center, by quadrants; pixels beyond the screen read as white
+static inline void lens_pixel(GBitmapDataRowInfo *dest, const GBitmapDataRowInfo *src, int x, int src_x, uint8_t white) {
+  if (x >= dest->min_x && x <= dest->max_x)
+    row_set_pixel(dest->data, x, src_x >= src->min_x && src_x <= src->max_x ? row_get_pixel(src->data, src_x) : white);
+}
+
+static void lens_area(BitmapInfo bitmap_info, GRect fb_bounds, int xCn, int yCn, int r, const int16_t *offsets) {
+  uint8_t white = pixel_value(GColorWhite, FB_1BIT);
+  GBitmapDataRowInfo dest_below, dest_above, src_below, src_above;
+  for (int y = r; y >= 0; --y) {
+    int Y1 = offsets[y];
+    get_screen_row(bitmap_info, fb_bounds, yCn + y, &dest_below); get_screen_row(bitmap_info, fb_bounds, yCn - y, &dest_above);
+    get_screen_row(bitmap_info, fb_bounds, yCn + Y1, &src_below); get_screen_row(bitmap_info, fb_bounds, yCn - Y1, &src_above);
+    for (int x = r; x >= 0; --x)
+      if (x*x+y*y < r*r) {
+        int X1 = offsets[x];
+        lens_pixel(&dest_below, &src_below, xCn + x, xCn + X1, white);
+        lens_pixel(&dest_below, &src_below, xCn - x, xCn - X1, white);
+        lens_pixel(&dest_above, &src_above, xCn + x, xCn + X1, white);
+        lens_pixel(&dest_above, &src_above, xCn - x, xCn - X1, white);
       }
-     }
-  
-  graphics_release_frame_buffer(ctx, fb);
+  }
 }
 
-// Zoom effect.
+// Lens effect.
 // Added by Ron64
-// Parameter: Y zoom (high byte) X zoom(low byte),  0x10 no zoom 0x20 200% 0x08 50%, 
-// use the percentage macro EL_ZOOM(150,60). In this example: Y- zoom in 150%, X- zoom out to 60% 
-void effect_zoom(GContext* ctx,  GRect position, void* param){
-  GBitmap *fb = graphics_capture_frame_buffer(ctx);
+// Parameters: lens focal(high byte) and object distance(low byte)
+void effect_lens(GContext* ctx,  GRect position, void* param){
+  uint8_t d,r;
+  int xCn, yCn; // center can be off screen, on either side
+
+  d=position.size.w;
+  if (position.size.h < d)
+    d= position.size.h;
+  r= d/2; // radius of lens
+  uint8_t focal =   (int32_t)param >>8 & 0xFF;// focal point of lens
+  uint8_t obj_dis = (int32_t)param & 0xFF;//distance of object from focal point.
+  
+  int16_t *offsets = get_lens_table(focal, obj_dis, r);
+  if (!offsets) return;
+  
+  GBitmap *fb = effect_capture_frame_buffer(ctx);
   
   BitmapInfo bitmap_info;
   bitmap_info.bitmap = fb;
@@ -561,72 +1489,189 @@ void effect_zoom(GContext* ctx,  GRect position, void* param){
   bitmap_info.bytes_per_row = gbitmap_get_bytes_per_row(fb);
   bitmap_info.bitmap_format = gbitmap_get_format(fb);
 
-  uint8_t xCn, yCn, Y1,X1, ratioY, ratioX;
   xCn= position.origin.x + position.size.w /2;
   yCn= position.origin.y + position.size.h /2;
+  
+  lens_area(bitmap_info, gbitmap_get_bounds(fb), xCn, yCn, r, offsets);
+  effect_release_frame_buffer(ctx, fb);
+}
+  
+// coverage cache of mask effect: which pixels of the area come out in mask colors once the mask is drawn.
+// Rebuilt only when the mask (text, font, bitmap and its bounds, colors, layout) or position change, or after
+// effect_mask_invalidate.
+typedef struct {
+  EffectCache cache;
+  GRect position;
+  char *text; // copy of mask text, NULL for bitmap masks
+  GFont font;
+  GBitmap *bitmap_mask;
+  GRect bitmap_bounds;
+  uint32_t generation; // s_mask_generation the cache was built in
+  uint8_t *mask_colors; // copy of mask colors up to GColorClear, as argb
+  GColor background_color;
+  GTextOverflowMode text_overflow;
+  GTextAlignment text_align;
+  uint8_t *coverage; // 1 bit per pixel of position clipped to the screen, rows of (w + 7) / 8 bytes
+  GBitmapFormat bg_format;
+  GBitmapFormat fb_format;
+  bool translate_built;
+  uint8_t translate[256]; // PalColor from bg_format to fb_format for every background pixel value
+} MaskCache;
 
-  ratioY= (int32_t)param >>8 & 0xFF;
-  ratioX= (int32_t)param & 0xFF;
-
-  for (int y = 0; y <= position.size.h>>1; y++)
-    for (int x = 0; x <= position.size.w>>1; x++)
-    {
-      //yS,xS scan source: centre to out or out to centre
-      int8_t yS = (ratioY>16) ? (position.size.h/2)- y: y; 
-      int8_t xS = (ratioX>16) ? (position.size.w/2)- x: x;
-      Y1= (yS<<4) /ratioY;
-      X1= (xS<<4) /ratioX;
-      set_pixel(bitmap_info, yCn +yS, xCn +xS, get_pixel(bitmap_info, yCn +Y1, xCn +X1)); 
-      set_pixel(bitmap_info, yCn +yS, xCn -xS, get_pixel(bitmap_info, yCn +Y1, xCn -X1));
-      set_pixel(bitmap_info, yCn -yS, xCn +xS, get_pixel(bitmap_info, yCn -Y1, xCn +X1));
-      set_pixel(bitmap_info, yCn -yS, xCn -xS, get_pixel(bitmap_info, yCn -Y1, xCn -X1));
-    }
-  graphics_release_frame_buffer(ctx, fb);
-//Todo: Should probably reduce Y size on zoom out or limit reading beyond edge of screen.
+static EffectCache *s_mask_direct;
+static uint32_t s_mask_generation; // bumped by effect_mask_invalidate
+
+void effect_mask_invalidate(void) {
+  s_mask_generation++;
 }
 
-// Lens effect.
-// Added by Ron64
-// Parameters: lens focal(high byte) and object distance(low byte)
-void effect_lens(GContext* ctx,  GRect position, void* param){
-  GBitmap *fb = graphics_capture_frame_buffer(ctx);
+static void mask_cache_destroy(EffectCache *cache) {
+  MaskCache *mask_cache = (MaskCache *)cache;
+  free(mask_cache->text);
+  free(mask_cache->mask_colors);
+  free(mask_cache->coverage);
+  free(cache);
+}
+
+static bool mask_colors_equal(const uint8_t *copy, const GColor *colors) {
+  int i = 0;
+  for (; !gcolor_equal(colors[i], GColorClear); i++)
+    if (copy[i] != colors[i].argb) return false;
+  return copy[i] == GColorClear.argb;
+}
+
+static GRect mask_bitmap_bounds(EffectMask *mask) {
+  return mask->bitmap_mask ? gbitmap_get_bounds(mask->bitmap_mask) : GRect(0, 0, 0, 0);
+}
+
+static bool mask_cache_valid(MaskCache *mask_cache, EffectMask *mask, GRect position) {
+  GRect bitmap_bounds = mask_bitmap_bounds(mask);
+  return mask_cache->coverage && mask_cache->generation == s_mask_generation && grect_equal(&mask_cache->position, &position) &&
+         mask_cache->font == mask->font && mask_cache->bitmap_mask == mask->bitmap_mask &&
+         grect_equal(&mask_cache->bitmap_bounds, &bitmap_bounds) &&
+         mask_colors_equal(mask_cache->mask_colors, mask->mask_colors) && gcolor_equal(mask_cache->background_color, mask->background_color) &&
+         mask_cache->text_overflow == mask->text_overflow && mask_cache->text_align == mask->text_align &&
+         (mask->text ? mask_cache->text && strcmp(mask_cache->text, mask->text) == 0 : !mask_cache->text);
+}
+
+// copies visible pixels of area from framebuffer to "buffer" (area.size.h rows of "stride" bytes) or back,
+// 1bit rows are copied as whole bytes
+static void copy_area(BitmapInfo bitmap_info, GRect area, uint8_t *buffer, int stride, bool to_framebuffer) {
+  bool one_bit = FB_1BIT;
+  GBitmapDataRowInfo span;
+  
+  for (int r = 0; r < area.size.h; r++) {
+    if (!get_row_span(bitmap_info, area.origin.y + r, area, &span)) continue;
+    uint8_t *fb_data = one_bit ? span.data + area.origin.x / 8 : span.data + span.min_x;
+    uint8_t *buffer_data = one_bit ? buffer + r*stride : buffer + r*stride + span.min_x - area.origin.x;
+    int count = one_bit ? stride : span.max_x - span.min_x + 1;
+    if (to_framebuffer) memcpy(fb_data, buffer_data, count); else memcpy(buffer_data, fb_data, count);
+  }
+}
+
+// sets visible pixels of area to value, 1bit rows as whole bytes like copy_area (which puts the neighbours back)
+static void fill_area(BitmapInfo bitmap_info, GRect area, int stride, uint8_t value) {
+  bool one_bit = FB_1BIT;
+  GBitmapDataRowInfo span;
   
+  for (int r = 0; r < area.size.h; r++) {
+    if (!get_row_span(bitmap_info, area.origin.y + r, area, &span)) continue;
+    if (one_bit) memset(span.data + area.origin.x / 8, value ? 0xFF : 0, stride);
+    else memset(span.data + span.min_x, value, span.max_x - span.min_x + 1);
+  }
+}
+
+// draws the mask on a fill no mask color matches (the background color when there is one, as effect_mask has just
+// drawn it) and records which pixels of area come out in mask colors, then puts back what was under the mask - so
+// coverage depends on the mask alone, not on what the screen held when it was built
+static void build_mask_cache(MaskCache *mask_cache, GContext* ctx, GRect position, GRect area, EffectMask *mask) {
+  free(mask_cache->coverage);
+  free(mask_cache->text);
+  free(mask_cache->mask_colors);
+  mask_cache->coverage = NULL;
+  mask_cache->text = NULL;
+  
+  int color_count = 0;
+  while (!gcolor_equal(mask->mask_colors[color_count], GColorClear)) color_count++;
+  mask_cache->mask_colors = malloc(color_count + 1);
+  if (!mask_cache->mask_colors) return;
+  for (int i = 0; i <= color_count; i++) mask_cache->mask_colors[i] = mask->mask_colors[i].argb;
+  if (mask->text) {
+    mask_cache->text = malloc(strlen(mask->text) + 1);
+    if (!mask_cache->text) return;
+    strcpy(mask_cache->text, mask->text);
+  }
+  
+  GBitmap *fb = effect_capture_frame_buffer(ctx);
   BitmapInfo bitmap_info;
   bitmap_info.bitmap = fb;
   bitmap_info.bitmap_data =  gbitmap_get_data(fb);
   bitmap_info.bytes_per_row = gbitmap_get_bytes_per_row(fb);
   bitmap_info.bitmap_format = gbitmap_get_format(fb);
+  bool one_bit = FB_1BIT;
   
-  uint8_t d,r, xCn, yCn;
-
-  xCn= position.origin.x + position.size.w /2;
-  yCn= position.origin.y + position.size.h /2;
-  d=position.size.w;
-  if (position.size.h < d)
-    d= position.size.h;
-  r= d/2; // radius of lens
-  float focal =   (int32_t)param >>8 & 0xFF;// focal point of lens
-  float obj_dis = (int32_t)param & 0xFF;//distance of object from focal point.
+  // framebuffer values of mask colors
+  bool is_mask[256] = {false};
+  for (int i = 0; i < color_count; i++) is_mask[pixel_value(mask->mask_colors[i], one_bit)] = true;
+  int fill = -1; // none needed over the background color, none possible when every value is a mask color
+  if (gcolor_equal(mask->background_color, GColorClear))
+    for (int c = 0; c < (one_bit ? 2 : 256) && fill < 0; c++) if (!is_mask[c]) fill = c;
   
-  for (int y = r; y >= 0; --y)
-    for (int x = r; x >= 0; --x)
-      if (x*x+y*y < r*r)
-      {
-        int Y1= my_tan(my_asin(y/focal))*obj_dis;
-        int X1= my_tan(my_asin(x/focal))*obj_dis;
-        set_pixel(bitmap_info, yCn +y, xCn +x, get_pixel(bitmap_info, yCn +Y1, xCn +X1)); 
-        set_pixel(bitmap_info, yCn +y, xCn -x, get_pixel(bitmap_info, yCn +Y1, xCn -X1));
-        set_pixel(bitmap_info, yCn -y, xCn +x, get_pixel(bitmap_info, yCn -Y1, xCn +X1));
-        set_pixel(bitmap_info, yCn -y, xCn -x, get_pixel(bitmap_info, yCn -Y1, xCn -X1));
-      }
-    graphics_release_frame_buffer(ctx, fb);
-//Todo: Change to lock-up arcsin table in the future. (Currently using floating point math library that is relatively big & slow)
-}
+  int coverage_stride = (area.size.w + 7) / 8;
+  int saved_stride = one_bit ? (area.origin.x + area.size.w - 1) / 8 - area.origin.x / 8 + 1 : area.size.w;
+  uint8_t *saved = malloc(saved_stride * area.size.h);
+  mask_cache->coverage = calloc(coverage_stride * area.size.h, 1);
+  if (!saved || !mask_cache->coverage) {
+    free(saved);
+    free(mask_cache->coverage);
+    mask_cache->coverage = NULL;
+    effect_release_frame_buffer(ctx, fb);
+    return;
+  }
+  copy_area(bitmap_info, area, saved, saved_stride, false);
+  if (fill >= 0) fill_area(bitmap_info, area, saved_stride, fill);
+  effect_release_frame_buffer(ctx, fb);
+  
+  //if text mask is used - drawing text
+  if (mask->text) {
+     graphics_context_set_text_color(ctx, mask->mask_colors[0]); // for text using only 1st color from array of mask colors
+     graphics_draw_text(ctx, mask->text, mask->font, GRect(0, 0, position.size.w, position.size.h), mask->text_overflow, mask->text_align, NULL);
+  } else if (mask->bitmap_mask) { // othersise - bitmap mask is used - draw bimap
+     graphics_draw_bitmap_in_rect(ctx, mask->bitmap_mask, GRect(0, 0, position.size.w, position.size.h));
+  }
+  
+  fb = effect_capture_frame_buffer(ctx);
+  bitmap_info.bitmap = fb;
+  bitmap_info.bitmap_data =  gbitmap_get_data(fb);
+  
+  GBitmapDataRowInfo span;
+  for (int r = 0; r < area.size.h; r++) {
+    if (!get_row_span(bitmap_info, area.origin.y + r, area, &span)) continue;
+    uint8_t *coverage = mask_cache->coverage + r*coverage_stride; // indexed by x - area.origin.x
+    for (int x = span.min_x; x <= span.max_x; x++)
+      if (is_mask[row_get_pixel(span.data, x)]) coverage[(x - area.origin.x) / 8] |= 1 << ((x - area.origin.x) % 8);
+  }
   
+  copy_area(bitmap_info, area, saved, saved_stride, true);
+  free(saved);
+  effect_release_frame_buffer(ctx, fb);
+  
+  mask_cache->position = position;
+  mask_cache->font = mask->font;
+  mask_cache->bitmap_mask = mask->bitmap_mask;
+  mask_cache->bitmap_bounds = mask_bitmap_bounds(mask);
+  mask_cache->generation = s_mask_generation;
+  mask_cache->background_color = mask->background_color;
+  mask_cache->text_overflow = mask->text_overflow;
+  mask_cache->text_align = mask->text_align;
+}
+
 // mask effect.
 // see struct EffectMask for parameter description  
+// The mask is drawn only when it changes, to find which pixels are in mask colors (kept as a 1bit coverage bitmap);
+// every frame then just copies background bitmap pixels under the coverage, translated by a prebuilt palette table.
+// Draws the mask through the graphics context, so it is listed in s_drawing_effects.
 void effect_mask(GContext* ctx, GRect position, void* param) {
-  GColor temp_pixel;  
   EffectMask *mask = (EffectMask *)param;
 
   //drawing background - only if real color is passed
@@ -635,22 +1680,25 @@ void effect_mask(GContext* ctx, GRect position, void* param) {
     graphics_fill_rect(ctx, GRect(0, 0, position.size.w, position.size.h), 0, GCornerNone); 
   }  
   
-  //if text mask is used - drawing text
-  if (mask->text) {
-     graphics_context_set_text_color(ctx, mask->mask_colors[0]); // for text using only 1st color from array of mask colors
-     graphics_draw_text(ctx, mask->text, mask->font, GRect(0, 0, position.size.w, position.size.h), mask->text_overflow, mask->text_align, NULL);
-  } else if (mask->bitmap_mask) { // othersise - bitmap mask is used - draw bimap
-     graphics_draw_bitmap_in_rect(ctx, mask->bitmap_mask, GRect(0, 0, position.size.w, position.size.h));
-  }
+  GBitmap *fb = effect_capture_frame_buffer(ctx);
+  GRect area = clip_rect(position, gbitmap_get_bounds(fb));
+  effect_release_frame_buffer(ctx, fb);
+  if (area.size.w == 0 || area.size.h == 0) return;
+  
+  MaskCache *mask_cache = (MaskCache *)get_cache(&s_mask_direct, mask_cache_destroy, sizeof(MaskCache));
+  if (!mask_cache) return;
+  if (!mask_cache_valid(mask_cache, mask, position)) build_mask_cache(mask_cache, ctx, position, area, mask);
+  if (!mask_cache->coverage) return;
     
   //capturing framebuffer bitmap
-  GBitmap *fb = graphics_capture_frame_buffer(ctx);
+  fb = effect_capture_frame_buffer(ctx);
   
   BitmapInfo bitmap_info;
   bitmap_info.bitmap = fb;
   bitmap_info.bitmap_data =  gbitmap_get_data(fb);
   bitmap_info.bytes_per_row = gbitmap_get_bytes_per_row(fb);
   bitmap_info.bitmap_format = gbitmap_get_format(fb);
+  bool one_bit = FB_1BIT;
   
   //capturing background bitmap
   BitmapInfo bg_bitmap_info;
@@ -658,23 +1706,63 @@ void effect_mask(GContext* ctx, GRect position, void* param) {
   bg_bitmap_info.bitmap_data =  gbitmap_get_data(mask->bitmap_background);
   bg_bitmap_info.bytes_per_row =  gbitmap_get_bytes_per_row(mask->bitmap_background);
   bg_bitmap_info.bitmap_format = gbitmap_get_format(mask->bitmap_background);
+  GRect bg_bounds = gbitmap_get_bounds(mask->bitmap_background);
+  bool bg_8bit = bg_bitmap_info.bitmap_format == GBitmapFormat8Bit; // rows of plain 8bit bitmap are read directly
   
-  //looping throughout layer replacing mask with bg bitmap
-  for (int y = 0; y < position.size.h; y++)
-     for (int x = 0; x < position.size.w; x++) {
-      temp_pixel = (GColor)get_pixel(bitmap_info, y + position.origin.y, x + position.origin.x);
-       if ( gcolor_contains(mask->mask_colors, temp_pixel)) { // if array of mask colors matches current screen pixel color:
-         // getting pixel from background bitmap (adjusted to pallette by PalColor function because palette of bg bitmap and framebuffer may differ)
-         // YG OCT-25-2015: replaced "y + position.origin.y, x + position.origin.x" with "y + 0, x + 0" since in mask bitmap we start without offset
-         set_pixel(bitmap_info, y + position.origin.y, x + position.origin.x, PalColor(get_pixel(bg_bitmap_info, y + 0, x + 0), bg_bitmap_info.bitmap_format, bitmap_info.bitmap_format));
-       } 
-  
+  // palette of bg bitmap and framebuffer may differ - translation of every value, built once per pair of formats
+  if (mask_cache->bg_format != bg_bitmap_info.bitmap_format || mask_cache->fb_format != bitmap_info.bitmap_format || !mask_cache->translate_built) {
+    mask_cache->bg_format = bg_bitmap_info.bitmap_format;
+    mask_cache->fb_format = bitmap_info.bitmap_format;
+    for (int c = 0; c < 256; c++) mask_cache->translate[c] = PalColor(c, bg_bitmap_info.bitmap_format, bitmap_info.bitmap_format);
+    mask_cache->translate_built = true;
   }
   
-  graphics_release_frame_buffer(ctx, fb);
+  // background bitmap starts at position origin, pixels beyond it are left as they are
+  int coverage_stride = (area.size.w + 7) / 8;
+  int bg_x_end = position.origin.x + bg_bounds.size.w - 1;
+  EffectRowIterator rows;
+  effect_row_iterator_init(&rows, bitmap_info, area);
+  
+  // 1bit background on 1bit framebuffer needs no translation: covered pixels are blended in a word at a time
+  bool words = one_bit && bg_bitmap_info.bitmap_format == GBitmapFormat1Bit;
+  int count = bitmap_info.bytes_per_row < MAX_ROW_WORDS*4 ? bitmap_info.bytes_per_row : MAX_ROW_WORDS*4;
+  int n = (count + 3) / 4;
+  uint32_t covered[MAX_ROW_WORDS], bg_words[MAX_ROW_WORDS], fb_words[MAX_ROW_WORDS];
+  
+  while (effect_row_iterator_next(&rows)) {
+    int y = rows.y, r = y - area.origin.y;
+    if (y - position.origin.y >= bg_bounds.size.h) break;
+    int max_x = rows.x_end < bg_x_end ? rows.x_end : bg_x_end;
+    
+    if (words) {
+      bits_load(covered, n, mask_cache->coverage + r*coverage_stride, coverage_stride, area.origin.x);
+      bits_clip(covered, n, rows.x_start, max_x);
+      bits_load(bg_words, n, bg_bitmap_info.bitmap_data + (y - position.origin.y) * bg_bitmap_info.bytes_per_row,
+                bg_bitmap_info.bytes_per_row, position.origin.x);
+      bits_load(fb_words, n, rows.row, count, 0);
+      for (int i = 0; i < n; i++) fb_words[i] = (fb_words[i] & ~covered[i]) | (bg_words[i] & covered[i]);
+      bits_store(rows.row, count, fb_words);
+      continue;
+    }
+    
+    const uint8_t *coverage = mask_cache->coverage + r*coverage_stride;
+    // background bitmap is read at "y - position.origin.y, x - position.origin.x" since in mask bitmap we start without offset
+    const uint8_t *bg_row = bg_bitmap_info.bitmap_data + (y - position.origin.y) * bg_bitmap_info.bytes_per_row - position.origin.x;
+    for (int i = 0; i < coverage_stride; i++) {
+      if (!coverage[i]) continue; // nothing masked in these 8 pixels
+      for (int bit = 0; bit < 8; bit++) {
+        int x = area.origin.x + i*8 + bit;
+        if (!(coverage[i] & (1 << bit)) || x < rows.x_start || x > max_x) continue;
+        uint8_t bg_pixel = bg_8bit ? bg_row[x] : get_pixel(bg_bitmap_info, y - position.origin.y, x - position.origin.x);
+        row_set_pixel(rows.row, x, mask_cache->translate[bg_pixel]);
+      }
+    }
+  }
   
+  effect_release_frame_buffer(ctx, fb);
 }
 
+// draws its text through the graphics context, so it is listed in s_drawing_effects
 void effect_fps(GContext* ctx, GRect position, void* param) {
   static GFont font = NULL;
   static char buff[16];
@@ -698,20 +1786,155 @@ void effect_fps(GContext* ctx, GRect position, void* param) {
 }
 
 
+// long shadow: every orig_color pixel of position casts a line towards its offset, stepped as set_line steps it,
+// drawn over the pixels that are not orig_color. Step k of every line is at the same (dx, dy) from its source pixel,
+// so with the sources of each row gathered as bits, pixels covered in row y are the source rows y - dy moved by dx,
+// ORed over the steps (steps sharing dx are moved at once): a single sweep over the rows, a few words per row and
+// step. Lines are cast from the pixels as they are before the effect - shadow drawn in orig_color doesn't cast
+// shadow itself. On Aplite lines are "lined": a pixel at an even position along the major axis of the offset gets
+// offset_color, one at an odd position the other color.
+static void long_shadow(BitmapInfo bitmap_info, GRect fb_bounds, GRect position, EffectOffset *shadow) {
+  GRect source = clip_rect(position, fb_bounds);
+  bool y_major = abs(shadow->offset_y) > abs(shadow->offset_x);
+  int major_offset = y_major ? shadow->offset_y : shadow->offset_x;
+  int minor_offset = y_major ? shadow->offset_x : shadow->offset_y;
+  int length = abs(major_offset);
+  if (source.size.w == 0 || source.size.h == 0 || length == 0) return;
+  
+  int dir = major_offset < 0 ? -1 : 1;
+  int step = dir * (minor_offset * 256 / major_offset); // minor axis advance per step in 8.8 fixed point, as in set_line
+  bool one_bit = FB_1BIT;
+  uint8_t orig_color = pixel_value(shadow->orig_color, one_bit);
+  uint8_t draw_color = pixel_value(shadow->offset_color, one_bit);
+  int count = bitmap_info.bytes_per_row < MAX_ROW_WORDS*4 ? bitmap_info.bytes_per_row : MAX_ROW_WORDS*4;
+  
+  // columns lines reach on screen: bit rows cover them from "base" (a word boundary), n words a row
+  int dx_end = y_major ? (0x80 + length*step) >> 8 : major_offset;
+  int x0 = source.origin.x + (dx_end < 0 ? dx_end : 0);
+  int x1 = source.origin.x + source.size.w - 1 + (dx_end > 0 ? dx_end : 0);
+  if (x0 < 0) x0 = 0;
+  if (x1 > fb_bounds.size.w - 1) x1 = fb_bounds.size.w - 1;
+  int base = x0 & ~31;
+  int n = (x1 - base) / 32 + 1;
+  
+  uint32_t *sources = effect_scratch_alloc(sizeof(uint32_t) * n * source.size.h); // orig_color pixels of every row
+  if (!sources) return;
+  
+  GBitmapDataRowInfo span;
+  for (int r = 0; r < source.size.h; r++) {
+    uint32_t *words = sources + r*n;
+    memset(words, 0, sizeof(uint32_t) * n);
+    if (!get_row_span(bitmap_info, source.origin.y + r, source, &span)) continue;
+    if (one_bit) {
+      bits_load(words, n, span.data, count, -base);
+      if (!orig_color) for (int i = 0; i < n; i++) words[i] = ~words[i];
+      bits_clip(words, n, span.min_x - base, span.max_x - base);
+    } else {
+      for (int x = span.min_x; x <= span.max_x; x++)
+        if (row_get_pixel(span.data, x) == orig_color) words[(x - base) / 32] |= 1u << ((x - base) % 32);
+    }
+  }
+  
+  // rows lines reach on screen
+  int dy_end = y_major ? major_offset : (0x80 + length*step) >> 8;
+  int y0 = source.origin.y + (dy_end < 0 ? dy_end : 0);
+  int y1 = source.origin.y + source.size.h - 1 + (dy_end > 0 ? dy_end : 0);
+  if (y0 < 0) y0 = 0;
+  if (y1 > fb_bounds.size.h - 1) y1 = fb_bounds.size.h - 1;
+  
+  // Aplite: major positions of the parity drawn in orig_color - only those pixels change, the rest already are
+  // the other color
+  bool odd_orig = draw_color != orig_color;
+  
+  uint32_t covered[MAX_ROW_WORDS], run[MAX_ROW_WORDS], moved[MAX_ROW_WORDS];
+  for (int y = y0; y <= y1; y++) {
+    bool any = false, in_run = false;
+    memset(covered, 0, sizeof(uint32_t) * n);
+    memset(run, 0, sizeof(uint32_t) * n);
+    for (int k = 0; k <= length; k++) {
+      int minor = (0x80 + k*step) >> 8;
+      int dx = y_major ? minor : dir*k, dy = y_major ? dir*k : minor;
+      int r = y - dy - source.origin.y;
+      if (r >= 0 && r < source.size.h) {
+        uint32_t seen = 0;
+        for (int i = 0; i < n; i++) { run[i] |= sources[r*n + i]; seen |= sources[r*n + i]; }
+        if (seen) in_run = true;
+      }
+      int next_dx = y_major ? (0x80 + (k + 1)*step) >> 8 : dir*(k + 1);
+      if (!in_run || (k < length && next_dx == dx)) continue;
+      bits_shift(moved, run, n, dx);
+      for (int i = 0; i < n; i++) { covered[i] |= moved[i]; run[i] = 0; }
+      in_run = false; any = true;
+    }
+    if (!any || !get_screen_row(bitmap_info, fb_bounds, y, &span)) continue;
+    
+    if (one_bit) {
+      uint32_t lined = y_major ? ((y & 1) == odd_orig ? 0xFFFFFFFF : 0) : (odd_orig ? 0xAAAAAAAA : 0x55555555);
+      for (int i = 0; i < n; i++) covered[i] &= lined;
+      bits_clip(covered, n, span.min_x - base, span.max_x - base);
+      for (int i = 0; i < n; i++) {
+        uint32_t pixels = bits_get_word(span.data, count, base + i*32);
+        bits_put_word(span.data, count, base + i*32, orig_color ? pixels | covered[i] : pixels & ~covered[i]);
+      }
+    } else {
+      for (int i = 0; i < n; i++)
+        for (uint32_t bits = covered[i]; bits; bits &= bits - 1) {
+          int x = base + i*32 + __builtin_ctz(bits);
+          if (x < span.min_x) continue;
+          if (x > span.max_x) break;
+          if (row_get_pixel(span.data, x) != orig_color) row_set_pixel(span.data, x, draw_color);
+        }
+    }
+  }
+  
+  effect_scratch_free(sources);
+}
+
+// shadow on 1bit framebuffer, a row of 32-bit words at a time: pixel that isn't orig_color already is the only other
+// color, so only offset_color equal to orig_color changes anything - shadow pixels turn orig_color and cast shadow
+// themselves when their row is reached later (or further in the same row)
+static void shadow_1bit(BitmapInfo bitmap_info, GRect fb_bounds, GRect position, EffectOffset *shadow, uint8_t orig_color, uint8_t offset_color) {
+  int ox = shadow->offset_x, oy = shadow->offset_y;
+  if (orig_color != offset_color || (ox == 0 && oy == 0)) return;
+  
+  int count = bitmap_info.bytes_per_row < MAX_ROW_WORDS*4 ? bitmap_info.bytes_per_row : MAX_ROW_WORDS*4;
+  int n = (count + 3) / 4;
+  uint32_t source[MAX_ROW_WORDS], moved[MAX_ROW_WORDS];
+  EffectRowIterator rows;
+  GBitmapDataRowInfo target;
+  effect_row_iterator_init(&rows, bitmap_info, position);
+  
+  while (effect_row_iterator_next(&rows)) {
+    int shadow_y = rows.y + oy;
+    if (!get_screen_row(bitmap_info, fb_bounds, shadow_y, &target)) continue;
+    
+    // orig_color pixels of the row
+    bits_load(source, n, rows.row, count, 0);
+    if (!orig_color) for (int i = 0; i < n; i++) source[i] = ~source[i];
+    bits_clip(source, n, rows.x_start, rows.x_end);
+    
+    // shadow falling further into the same row: sources repeat every ox pixels to the end of the span
+    if (oy == 0 && ox > 0) {
+      for (int step = ox; step <= rows.x_end - rows.x_start; step *= 2) {
+        bits_shift(moved, source, n, step);
+        for (int i = 0; i < n; i++) source[i] |= moved[i];
+      }
+      bits_clip(source, n, rows.x_start, rows.x_end);
+    }
+    
+    bits_shift(moved, source, n, ox);
+    bits_clip(moved, n, target.min_x, target.max_x);
+    bits_paint(target.data, count, moved, n, offset_color);
+  }
+}
+
 // shadow effect.
 // see struct EffecOffset for parameter description  
 void effect_shadow(GContext* ctx, GRect position, void* param) {
-  GColor temp_pixel;  
-  int shadow_x, shadow_y;
   EffectOffset *shadow = (EffectOffset *)param;
   
-  #ifndef PBL_COLOR
-    uint8_t draw_color = gcolor_equal(shadow->offset_color, GColorWhite)? 1 : 0;
-    uint8_t skip_color = gcolor_equal(shadow->orig_color, GColorWhite)? 1 : 0;
-  #endif
-  
    //capturing framebuffer bitmap
-  GBitmap *fb = graphics_capture_frame_buffer(ctx);
+  GBitmap *fb = effect_capture_frame_buffer(ctx);
   
   BitmapInfo bitmap_info;
   bitmap_info.bitmap = fb;
@@ -719,97 +1942,211 @@ void effect_shadow(GContext* ctx, GRect position, void* param) {
   bitmap_info.bytes_per_row = gbitmap_get_bytes_per_row(fb);
   bitmap_info.bitmap_format = gbitmap_get_format(fb);
 
+  if (shadow->option == 1) { // long shadow is a single sweep over the screen
+    long_shadow(bitmap_info, gbitmap_get_bounds(fb), position, shadow);
+    effect_release_frame_buffer(ctx, fb);
+    return;
+  }
+  
+  bool one_bit = FB_1BIT;
+  uint8_t orig_color = pixel_value(shadow->orig_color, one_bit);
+  uint8_t offset_color = pixel_value(shadow->offset_color, one_bit);
+  GRect fb_bounds = gbitmap_get_bounds(fb);
+  
+  if (one_bit) {
+    shadow_1bit(bitmap_info, fb_bounds, position, shadow, orig_color, offset_color);
+    effect_release_frame_buffer(ctx, fb);
+    return;
+  }
+  
+  EffectRowIterator rows;
+  GBitmapDataRowInfo target;
+  effect_row_iterator_init(&rows, bitmap_info, position);
   
   //looping throughout making shadow
-  for (int y = 0; y < position.size.h; y++)
-     for (int x = 0; x < position.size.w; x++) {
-       temp_pixel = (GColor)get_pixel(bitmap_info, y + position.origin.y, x + position.origin.x);
-       
-       if (gcolor_equal(temp_pixel, shadow->orig_color)) {
-         shadow_x =  x + position.origin.x + shadow->offset_x;
-         shadow_y =  y + position.origin.y + shadow->offset_y;
-         
-         if (shadow->option == 1) {
-            #ifdef PBL_COLOR // for Basalt simple calling line-drawing routine
-               set_line(bitmap_info, y + position.origin.y, x + position.origin.x, shadow_y, shadow_x, shadow->offset_color.argb, shadow->orig_color.argb, NULL);
-            #else // for Aplite - passing user-defined array to determine if pixels have been set or not
-               set_line(bitmap_info, y + position.origin.y, x + position.origin.x, shadow_y, shadow_x, draw_color, skip_color, shadow->aplite_visited); 
-            #endif
-           
-         } else {
-           
-             if (shadow_x >= 0 && shadow_x <=143 && shadow_y >= 0 && shadow_y <= 167) {
-             
-               temp_pixel = (GColor)get_pixel(bitmap_info, shadow_y, shadow_x);
-               if (!gcolor_equal(temp_pixel, shadow->orig_color) & !gcolor_equal(temp_pixel, shadow->offset_color) ) {
-                 #ifdef PBL_COLOR
-                    set_pixel(bitmap_info,  shadow_y, shadow_x, shadow->offset_color.argb);  
-                 #else
-                    set_pixel(bitmap_info,  shadow_y, shadow_x, gcolor_equal(shadow->offset_color, GColorWhite)? 1 : 0);
-                 #endif
-               }
-             }
-           
-         }
-         
-         
-       }
+  while (effect_row_iterator_next(&rows)) {
+    // visible part of the row the shadow of this row falls on
+    int shadow_y = rows.y + shadow->offset_y;
+    if (!get_screen_row(bitmap_info, fb_bounds, shadow_y, &target)) continue;
+    
+    // only pixels whose shadow lands on the visible part of the target row
+    int x_start = target.min_x - shadow->offset_x > rows.x_start ? target.min_x - shadow->offset_x : rows.x_start;
+    int x_end = target.max_x - shadow->offset_x < rows.x_end ? target.max_x - shadow->offset_x : rows.x_end;
+    
+    for (int x = x_start; x <= x_end; x++) {
+      if (row_get_pixel(rows.row, x) != orig_color) continue;
+      int shadow_x = x + shadow->offset_x;
+      
+      uint8_t pixel = row_get_pixel(target.data, shadow_x);
+      if (pixel != orig_color && pixel != offset_color) row_set_pixel(target.data, shadow_x, offset_color);
+    }
   }
          
-  graphics_release_frame_buffer(ctx, fb);
+  effect_release_frame_buffer(ctx, fb);
  
 }
 
+// horizontal dilation of source row sy for outline: every column x0..x1 within ox of an orig_color pixel
+// of the row (inside source) gets sy recorded in last_row
+static void dilate_row(BitmapInfo bitmap_info, int sy, GRect source, int x0, int x1, int ox, uint8_t orig_color, bool one_bit, int16_t *last_row) {
+  GBitmapDataRowInfo span;
+  if (!get_row_span(bitmap_info, sy, source, &span)) return;
+  
+  int last_x = x0 - ox - 1, k = span.min_x;
+  for (int x = x0; x <= x1; x++) {
+    for (; k <= span.max_x && k <= x + ox; k++)
+      if (row_get_pixel(span.data, k) == orig_color) last_x = k;
+    if (last_x >= x - ox) last_row[x - x0] = sy;
+  }
+}
+
+// outline on 1bit framebuffer, a row of 32-bit words at a time: pixel that isn't orig_color already is the only other
+// color, so only offset_color equal to orig_color changes anything - every covered pixel turns orig_color.
+// Source rows are dilated horizontally once and each painted row ORs the dilated rows of its vertical window.
+static void outline_1bit(BitmapInfo bitmap_info, GRect source, GRect reach, int ox, int oy, uint8_t orig_color, uint8_t offset_color) {
+  if (orig_color != offset_color) return;
+  
+  int count = bitmap_info.bytes_per_row < MAX_ROW_WORDS*4 ? bitmap_info.bytes_per_row : MAX_ROW_WORDS*4;
+  int n = (count + 3) / 4;
+  uint32_t *dilated = effect_scratch_alloc(sizeof(uint32_t) * n * source.size.h);
+  if (!dilated) return;
+  
+  // all source rows are dilated before painting, so painted pixels are never taken as source
+  GBitmapDataRowInfo span;
+  for (int r = 0; r < source.size.h; r++) {
+    uint32_t *words = dilated + r*n;
+    if (!get_row_span(bitmap_info, source.origin.y + r, source, &span)) {
+      memset(words, 0, sizeof(uint32_t) * n);
+      continue;
+    }
+    bits_load(words, n, span.data, count, 0);
+    if (!orig_color) for (int i = 0; i < n; i++) words[i] = ~words[i];
+    bits_clip(words, n, span.min_x, span.max_x);
+    bits_dilate(words, n, ox);
+  }
+  
+  uint32_t cover[MAX_ROW_WORDS];
+  for (int y = reach.origin.y; y < reach.origin.y + reach.size.h; y++) {
+    if (!get_row_span(bitmap_info, y, reach, &span)) continue;
+    
+    int r0 = y - oy - source.origin.y > 0 ? y - oy - source.origin.y : 0;
+    int r1 = y + oy - source.origin.y < source.size.h - 1 ? y + oy - source.origin.y : source.size.h - 1;
+    memset(cover, 0, sizeof(uint32_t) * n);
+    for (int r = r0; r <= r1; r++)
+      for (int i = 0; i < n; i++) cover[i] |= dilated[r*n + i];
+    
+    bits_clip(cover, n, span.min_x, span.max_x);
+    bits_paint(span.data, count, cover, n, offset_color);
+  }
+  
+  effect_scratch_free(dilated);
+}
+
+// outline effect.
+// Every pixel within offset_x horizontally and offset_y vertically of an orig_color pixel (and not orig_color itself)
+// is painted offset_color. Done as a separable dilation: each source row is dilated horizontally with a running scan,
+// and for every column the last source row that reached it is remembered, so the cost does not depend on thickness.
 void effect_outline(GContext* ctx, GRect position, void* param) {
-  GColor temp_pixel;  
-  int outlinex[8];
-  int outliney[8];
   EffectOffset *outline = (EffectOffset *)param;
+  int ox = outline->offset_x;
+  int oy = outline->offset_y;
+  if (ox < 0 || oy < 0) return;
   
    //capturing framebuffer bitmap
-  GBitmap *fb = graphics_capture_frame_buffer(ctx);
+  GBitmap *fb = effect_capture_frame_buffer(ctx);
   
   BitmapInfo bitmap_info;
   bitmap_info.bitmap = fb;
   bitmap_info.bitmap_data =  gbitmap_get_data(fb);
   bitmap_info.bytes_per_row = gbitmap_get_bytes_per_row(fb);
   bitmap_info.bitmap_format = gbitmap_get_format(fb);
-
   
-  //loop through pixels from framebuffer
-  for (int y = 0; y < position.size.h; y++)
-    for (int x = 0; x < position.size.w; x++) {
-      for (int a = 0; a <= outline->offset_x; a++) 
-        for (int b = 0; b <= outline->offset_y; b++) {
-  
-          temp_pixel = (GColor)get_pixel(bitmap_info, y + position.origin.y, x + position.origin.x);
-       
-          if (gcolor_equal(temp_pixel, outline->orig_color)) {
-            outlinex[0] = x + position.origin.x - a;
-            outliney[0] = y + position.origin.y - b;
-            outlinex[1] = x + position.origin.x + a;
-            outliney[1] = y + position.origin.y + b;
-            outlinex[2] = x + position.origin.x - a;
-            outliney[2] = y + position.origin.y + b;
-            outlinex[3] = x + position.origin.x + a;
-            outliney[3] = y + position.origin.y - b;
-         
-            for (int i = 0; i < 4; i++) {
-              // TODO: centralize the constants
-              if (outlinex[i] >= 0 && outlinex[i] <=144 && outliney[i] >= 0 && outliney[i] <= 168) {
-                temp_pixel = (GColor)get_pixel(bitmap_info, outliney[i], outlinex[i]);
-                if (!gcolor_equal(temp_pixel, outline->orig_color)) {
-                  #ifdef PBL_COLOR
-                    set_pixel(bitmap_info, outliney[i], outlinex[i], outline->offset_color.argb);  
-                  #else
-                    set_pixel(bitmap_info, outliney[i], outlinex[i], gcolor_equal(outline->offset_color, GColorWhite)? 1 : 0);
-                  #endif
-                }
-              }
-            }
-          }
-        }
+  GRect fb_bounds = gbitmap_get_bounds(fb);
+  bool one_bit = FB_1BIT;
+  uint8_t orig_color = pixel_value(outline->orig_color, one_bit);
+  uint8_t offset_color = pixel_value(outline->offset_color, one_bit);
+  
+  // source area (position clipped to the screen) and area the outline can reach
+  int sx0 = position.origin.x > 0 ? position.origin.x : 0;
+  int sy0 = position.origin.y > 0 ? position.origin.y : 0;
+  int sx1 = position.origin.x + position.size.w - 1 < fb_bounds.size.w - 1 ? position.origin.x + position.size.w - 1 : fb_bounds.size.w - 1;
+  int sy1 = position.origin.y + position.size.h - 1 < fb_bounds.size.h - 1 ? position.origin.y + position.size.h - 1 : fb_bounds.size.h - 1;
+  int x0 = sx0 - ox > 0 ? sx0 - ox : 0;
+  int y0 = sy0 - oy > 0 ? sy0 - oy : 0;
+  int x1 = sx1 + ox < fb_bounds.size.w - 1 ? sx1 + ox : fb_bounds.size.w - 1;
+  int y1 = sy1 + oy < fb_bounds.size.h - 1 ? sy1 + oy : fb_bounds.size.h - 1;
+  
+  GRect source = GRect(sx0, sy0, sx1 - sx0 + 1, sy1 - sy0 + 1);
+  GRect reach = GRect(x0, y0, x1 - x0 + 1, y1 - y0 + 1);
+  
+  if (one_bit) {
+    if (sx0 <= sx1 && sy0 <= sy1) outline_1bit(bitmap_info, source, reach, ox, oy, orig_color, offset_color);
+    effect_release_frame_buffer(ctx, fb);
+    return;
+  }
+  
+  // for every column of the reachable area: last source row whose horizontal dilation covers it
+  int16_t *last_row = (sx0 <= sx1 && sy0 <= sy1) ? effect_scratch_alloc(sizeof(int16_t) * (x1 - x0 + 1)) : NULL;
+  if (!last_row) {
+    effect_release_frame_buffer(ctx, fb);
+    return;
+  }
+  for (int x = x0; x <= x1; x++) last_row[x - x0] = y0 - oy - 1; // "never"
+  
+  GBitmapDataRowInfo span;
+  
+  // source rows above the reachable area (when clipped by the screen edge) are already in the window of its first row
+  for (int sy = sy0; sy < y0 + oy && sy <= sy1; sy++) dilate_row(bitmap_info, sy, source, x0, x1, ox, orig_color, one_bit, last_row);
+  
+  for (int y = y0; y <= y1; y++) {
+    // horizontal dilation of the source row entering the vertical window (pixels are only ever changed to offset_color
+    // which is not orig_color, so rows can be read after writing the ones above them)
+    int sy = y + oy;
+    if (sy >= sy0 && sy <= sy1) dilate_row(bitmap_info, sy, source, x0, x1, ox, orig_color, one_bit, last_row);
+    
+    // painting row covered by source rows y - oy .. y + oy
+    if (get_row_span(bitmap_info, y, reach, &span)) {
+      for (int x = span.min_x; x <= span.max_x; x++)
+        if (last_row[x - x0] >= y - oy && row_get_pixel(span.data, x) != orig_color)
+          row_set_pixel(span.data, x, offset_color);
     }
+  }
+  
+  effect_scratch_free(last_row);
+  effect_release_frame_buffer(ctx, fb);
+}
+
+// scratch taken by allocation of "size" bytes, including rounding kept by effect_scratch_alloc
+static size_t scratch_block(size_t size) {
+  return (size + 3) & ~(size_t)3;
+}
 
-  graphics_release_frame_buffer(ctx, fb);
+// most scratch memory the effect takes in a single call at position (matching its effect_scratch_alloc calls)
+size_t effect_scratch_size(effect_cb *effect, void *param, GRect position) {
+  size_t w = position.size.w < PBL_DISPLAY_WIDTH ? position.size.w : PBL_DISPLAY_WIDTH;
+  size_t h = position.size.h < PBL_DISPLAY_HEIGHT ? position.size.h : PBL_DISPLAY_HEIGHT;
+  
+  if (effect == effect_blur) {
+    size_t radius = (uint8_t)(uint32_t)param;
+    return scratch_block(sizeof(int32_t) * 4 * w) + scratch_block(w * (radius + 2));
+  } else if (effect == effect_zoom) {
+    return scratch_block(w);
+  } else if (effect == effect_rotate_90_degrees) {
+    return scratch_block(sizeof(RotateTile) * 4);
+  } else if (effect == effect_affine) {
+    return scratch_block(w * h) + scratch_block(sizeof(int16_t) * 2 * h);
+  } else if (effect == effect_shadow) {
+    if (((EffectOffset *)param)->option != 1) return 0;
+    // orig_color pixels of the clipped position as bits, whole rows of the screen
+    return scratch_block(sizeof(uint32_t) * ((PBL_DISPLAY_WIDTH + 31) / 32) * h);
+  } else if (effect == effect_outline) {
+#ifdef PBL_COLOR
+    int ox = ((EffectOffset *)param)->offset_x;
+    size_t reach = w + 2 * (ox > 0 ? ox : 0);
+    return scratch_block(sizeof(int16_t) * (reach < PBL_DISPLAY_WIDTH ? reach : PBL_DISPLAY_WIDTH));
+#else
+    return scratch_block(sizeof(uint32_t) * MAX_ROW_WORDS * h);
+#endif
+  }
+  return 0;
 }
@@ -8,6 +8,16 @@ typedef struct {
    int bytes_per_row;
    GBitmapFormat bitmap_format;
 }  BitmapInfo;
+
+// row span iterator over an effect area, see effect_row_iterator_init
+typedef struct {
+   BitmapInfo bitmap_info;
+   GRect area;        // effect position clipped to the screen
+   int16_t y;         // current row
+   uint8_t *row;      // data of the current row, indexed by x (by x / 8 on 1bit framebuffer)
+   int16_t x_start;   // first and last visible pixel of the current row
+   int16_t x_end;
+}  EffectRowIterator;
   
 // structure of mask for masking effects
 typedef struct {
@@ -35,15 +45,27 @@ typedef struct {
   int8_t offset_x; // horizontal ofset
   int8_t offset_y; // vertical offset
   int8_t option; // optional parameter (currently in effect_shadow 1=draw long shadow)
-  uint8_t *aplite_visited; // for Applite holds array of visited pixels
+  uint8_t *aplite_visited; // deprecated and ignored: long shadow keeps its own scratch. Kept so callers setting it still
+                           // build; leave it NULL, it is dropped at the next change that breaks EffectOffset anyway
 } EffectOffset;  
 
+// structure for affine transform effect: destination pixel at (x, y) from the center of the effect area
+// shows source pixel at (a*x + b*y + tx, c*x + d*y + ty) from the center, all values in 16.16 fixed point
+typedef struct {
+  int32_t a, b, tx;
+  int32_t c, d, ty;
+  GColor background_color; // color of pixels mapped from outside of the effect area
+} EffectAffine;
+
 // structure for color swap effect
 typedef struct {
   GColor firstColor;  // first color (target for colorize, one of set in colorswap)
   GColor secondColor; // second color (new color for colorize, other of set in colorswap)
 } EffectColorpair;
 
+// Effects get their layer frame in screen coordinates, unclipped: geometry (mirror axis, zoom and lens center,
+// mask origin) is relative to it, and it may extend beyond the screen. Each effect clips it to the framebuffer
+// bounds once, by row spans or by offset, and touches only visible pixels without per-pixel bound checks.
 typedef void effect_cb(GContext* ctx, GRect position, void* param);
 
 // inverter effect.
@@ -64,6 +86,13 @@ effect_cb effect_invert_bw_only;
 // Invert brightness of colors (retains hue, does not apply to black and white)
 effect_cb effect_invert_brightness;
 
+// Palette map effect - any color remap as a single table lookup per pixel (color platforms only)
+// Parameter: pointer to const uint8_t[256] map indexed by pixel's GColor.argb
+effect_cb effect_palette_map;
+
+// map used by effect_invert_brightness, can be copied as a starting point for custom maps
+extern const uint8_t effect_invert_brightness_map[256];
+
 // vertical mirror effect.
 // Added by Yuriy Galanter
 effect_cb effect_mirror_vertical;
@@ -91,6 +120,13 @@ effect_cb effect_zoom;
 
 #define EL_ZOOM(x,y) ((void*)((((y)*16/100)|(((x)*16/100)<<8))))
 
+// Affine transform effect (arbitrary rotation, scale, skew, shift)
+// see struct EffectAffine for parameter description
+effect_cb effect_affine;
+
+// sets EffectAffine to rotate by angle clockwise (TRIG_MAX_ANGLE is full turn) and zoom by scale (0x10000 is 100%)
+void effect_affine_rotate_scale(EffectAffine *affine, int32_t angle, int32_t scale);
+
 // Lens effect
 // Added by Ron64
 // Parameters: lens focal(high byte) and object distance(low byte)
@@ -102,8 +138,16 @@ effect_cb effect_lens;
 // mask effect.
 // Added by Yuriy Galanter
 // see struct EffectMask for parameter description
+// Background shows through the pixels the mask itself draws in mask colors (mask_colors is read up to GColorClear),
+// or everywhere when background_color is one of them. Which pixels those are is worked out once and cached, so unlike
+// drawing the mask every frame the mask is all or nothing: anti-aliased text edges and parts of the mask in other
+// colors are not drawn, and pixels of the screen already in mask colors are kept.
 effect_cb effect_mask;
 
+// The mask cache notices changes of the text, font, colors, layout, position and of the mask bitmap or its bounds,
+// but not pixels drawn into the same mask bitmap: call after changing those to have every mask rebuilt on next draw.
+void effect_mask_invalidate(void);
+
 // Just displays the average FPS of the app
 // Probably works better on a fullscreen effect layer so it can catch all redraw messages
 effect_cb effect_fps;
@@ -111,6 +155,54 @@ effect_cb effect_fps;
 // shadow effect
 // Added by Yuriy Galanter
 // uses EffecOffset as a parameter;
+// with option 1 (long shadow) every orig_color pixel casts a line to its offset, drawn over pixels that are not
+// orig_color; only pixels in orig_color before the effect cast lines. On Aplite lines are "lined": pixels at even
+// positions along the offset's longer axis get offset_color, those at odd positions the other color.
 effect_cb effect_shadow;
 
 effect_cb effect_outline;
+
+// Fusing of color-mapping effects (invert, invert_bw_only, invert_brightness, palette_map, colorize, colorswap)
+// composes color mapping of the effect into 256-entry map (map[c] = effect(map[c])), map can be NULL to only check the effect; 
+// returns false (leaving map intact) if effect is not a pure per-pixel color mapping
+bool effect_compose_color_map(effect_cb *effect, void *param, uint8_t *map);
+
+// applies color map composed by effect_compose_color_map to the given area in a single framebuffer pass
+void effect_apply_color_map(GContext* ctx, GRect position, const uint8_t *map);
+
+// Batching: effects capture the framebuffer through effect_capture_frame_buffer/effect_release_frame_buffer,
+// between effect_batch_begin and effect_batch_end they all share a single capture.
+// Effects drawing with graphics_* calls (effect_draws returns true, as listed in effects.c) must not run inside a batch.
+GBitmap* effect_capture_frame_buffer(GContext* ctx);
+void effect_release_frame_buffer(GContext* ctx, GBitmap *fb);
+void effect_batch_begin(GContext* ctx);
+void effect_batch_end(GContext* ctx);
+bool effect_draws(effect_cb *effect);
+
+// Row spans: walks the rows of position clipped to the screen, yielding only the pixels that are visible -
+// on round screen rows are cut to the circle and rows without visible pixels are skipped.
+//   effect_row_iterator_init(&rows, bitmap_info, position);
+//   while (effect_row_iterator_next(&rows)) for (x = rows.x_start; x <= rows.x_end; x++) ... rows.row ...
+void effect_row_iterator_init(EffectRowIterator *rows, BitmapInfo bitmap_info, GRect position);
+bool effect_row_iterator_next(EffectRowIterator *rows);
+
+// Lines: draws a line from (x, y) to (x2, y2), clipped to the bitmap, over the pixels that are not skip_color.
+// Colors are framebuffer values (argb on color, 1 for white and 0 for black on Aplite). On Aplite lines are "lined":
+// the color alternates from pixel to pixel, and pixels marked in visited (1 bit per pixel, laid out as the framebuffer,
+// may be NULL) are passed over while the ones drawn get marked. visited is ignored on color.
+void set_line(BitmapInfo bitmap_info, int y, int x, int y2, int x2, uint8_t draw_color, uint8_t skip_color, uint8_t *visited);
+
+// Scratch memory: buffers effects need only while running come from the arena set by effect_scratch_set
+// (EffectLayer keeps one sized by effect_scratch_size for its effects), so frames don't touch the heap.
+// Without an arena, or when it is too small, effect_scratch_alloc falls back to malloc.
+void effect_scratch_set(uint8_t *arena, size_t size);
+void* effect_scratch_alloc(size_t size);
+void effect_scratch_free(void *ptr);
+size_t effect_scratch_size(effect_cb *effect, void *param, GRect position);
+
+// Caches: tables effects derive from their parameters and rect (lens offsets, zoom maps, mask coverage) are kept
+// across frames in the slot set by effect_cache_set - EffectLayer keeps one for each of its effects and frees it with
+// effect_cache_free. Effects called on their own share one cache of each kind.
+typedef struct EffectCache EffectCache;
+void effect_cache_set(EffectCache **slot);
+void effect_cache_free(EffectCache *cache);
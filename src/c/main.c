@@ -1,5 +1,4 @@
 #include <pebble.h>
-#include "effect_layer.h"
 
 // Persistent storage key
 #define SETTINGS_KEY 1
@@ -8,18 +7,26 @@ static Window *s_main_window;
 static TextLayer *s_time_layer;
 static TextLayer *s_am_pm_layer;
 static TextLayer *s_date_layer;
-static BitmapLayer *s_background_layer;
+static Layer *s_background_layer;
 static GBitmap *s_background_bitmap;
 static GFont s_rwby_time_font;
 static GFont s_rwby_date_font;
-static int s_battery_level;
+static int s_battery_level = -1;
 static Layer *s_battery_layer;
-static Layer *s_battery_background_layer;
-static BitmapLayer *s_background_layer, *s_bt_icon_layer;
-static GBitmap *s_background_bitmap, *s_bt_icon_bitmap;
-static BitmapLayer *s_background_layer, *s_charge_icon_layer;
-static GBitmap *s_background_bitmap, *s_charge_icon_bitmap;
-static EffectLayer *s_effect_layer;
+static BitmapLayer *s_bt_icon_layer;
+static GBitmap *s_bt_icon_bitmap;
+static BitmapLayer *s_charge_icon_layer;
+static GBitmap *s_charge_icon_bitmap;
+
+// Copy of the framebuffer holding the composited static background (NULL until rendered)
+static uint8_t *s_background_cache;
+// Set when there was no memory for the cache: the background is then drawn directly until the theme changes
+static bool s_background_cache_failed;
+
+// Colors of the current theme
+static GColor s_foreground_color;
+static GColor s_background_color;
+static bool s_bitmaps_inverted;
 
 
 // Define our settings struct
@@ -48,12 +55,67 @@ static void clay_load_settings() {
   persist_read_data(SETTINGS_KEY, &settings, sizeof(settings));
 }
 
+// Inverts colors of a bitmap in place: the palette for palettized bitmaps, the pixels otherwise
+static void invert_bitmap(GBitmap *bitmap) {
+    GBitmapFormat format = gbitmap_get_format(bitmap);
+    int palette_size = 0;
+
+    switch (format) {
+        case GBitmapFormat1BitPalette: palette_size = 2; break;
+        case GBitmapFormat2BitPalette: palette_size = 4; break;
+        case GBitmapFormat4BitPalette: palette_size = 16; break;
+        default: break;
+    }
+
+    if (palette_size > 0) {
+        // Keep alpha bits, flip color bits
+        GColor *palette = gbitmap_get_palette(bitmap);
+        for (int i = 0; i < palette_size; i++) {
+            palette[i].argb ^= 0x3F;
+        }
+        return;
+    }
+
+    GRect bounds = gbitmap_get_bounds(bitmap);
+    uint8_t *data = gbitmap_get_data(bitmap);
+    int size = gbitmap_get_bytes_per_row(bitmap) * (bounds.origin.y + bounds.size.h);
+    uint8_t mask = format == GBitmapFormat1Bit ? 0xFF : 0x3F;
+    for (int i = 0; i < size; i++) {
+        data[i] ^= mask;
+    }
+}
+
+// Applies the theme once, when loaded or changed, so nothing has to be post-processed per frame
+static void apply_theme() {
+    bool dark = !settings.LightTheme;
+    s_foreground_color = dark ? GColorWhite : GColorBlack;
+    s_background_color = dark ? GColorBlack : GColorWhite;
+
+    window_set_background_color(s_main_window, s_background_color);
+    text_layer_set_text_color(s_time_layer, s_foreground_color);
+    text_layer_set_text_color(s_am_pm_layer, s_foreground_color);
+    text_layer_set_text_color(s_date_layer, s_foreground_color);
+
+    if (s_bitmaps_inverted != dark) {
+        invert_bitmap(s_background_bitmap);
+        invert_bitmap(s_bt_icon_bitmap);
+        invert_bitmap(s_charge_icon_bitmap);
+        s_bitmaps_inverted = dark;
+    }
+
+    // Static background has to be composited again with the new colors
+    free(s_background_cache);
+    s_background_cache = NULL;
+    s_background_cache_failed = false;
+    layer_mark_dirty(window_get_root_layer(s_main_window));
+}
+
 static void inbox_received_callback(DictionaryIterator *iterator, void *context) {   
     // Get the theme preferences
     Tuple *light_t = dict_find(iterator, MESSAGE_KEY_LightTheme);
     if (light_t) {
         settings.LightTheme = light_t->value->int32 == 1;
-        layer_set_hidden(effect_layer_get_layer(s_effect_layer), settings.LightTheme);
+        apply_theme();
     }
     
     clay_save_settings();
@@ -102,25 +164,104 @@ static void battery_update_proc(Layer *layer, GContext *ctx) {
     GRect bounds = layer_get_bounds(layer);
 
     // Find the width of the bar
-    int width = (int)(float)(((float)s_battery_level / 100.0F) * bounds.size.w);
+    GRect bar = GRect(1, 1, bounds.size.w - 2, bounds.size.h - 2);
+    int width = (int)(float)(((float)s_battery_level / 100.0F) * bar.size.w);
 
-    // Draw the background
-    graphics_context_set_fill_color(ctx, GColorWhite);
+    // Draw the frame
+    graphics_context_set_fill_color(ctx, s_foreground_color);
     graphics_fill_rect(ctx, bounds, 8, GCornersAll);
 
+    // Draw the background
+    graphics_context_set_fill_color(ctx, s_background_color);
+    graphics_fill_rect(ctx, bar, 8, GCornersAll);
+
     // Draw the bar
-    graphics_context_set_fill_color(ctx, GColorBlack);
-    graphics_fill_rect(ctx, GRect(0, 0, width, bounds.size.h), 8, GCornersAll);
+    graphics_context_set_fill_color(ctx, s_foreground_color);
+    graphics_fill_rect(ctx, GRect(bar.origin.x, bar.origin.y, width, bar.size.h), 8, GCornersAll);
+}
+
+// Copies the visible part of every framebuffer row to (to_cache = true) or from the cache
+static void copy_framebuffer(GBitmap *fb, uint8_t *cache, bool to_cache) {
+    GRect bounds = gbitmap_get_bounds(fb);
+
+    for (int y = 0; y < bounds.size.h; y++) {
+#ifdef PBL_COLOR
+        GBitmapDataRowInfo info = gbitmap_get_data_row_info(fb, y);
+        uint8_t *row = info.data + info.min_x;
+        int length = info.max_x - info.min_x + 1;
+#else
+        uint8_t *row = gbitmap_get_data(fb) + y * gbitmap_get_bytes_per_row(fb);
+        int length = gbitmap_get_bytes_per_row(fb);
+#endif
+        if (to_cache) {
+            memcpy(cache, row, length);
+        } else {
+            memcpy(row, cache, length);
+        }
+        cache += length;
+    }
 }
 
-static void battery_background_update_proc(Layer *layer, GContext *ctx) {
+// Returns number of bytes needed to cache the framebuffer
+static int framebuffer_cache_size(GBitmap *fb) {
+    GRect bounds = gbitmap_get_bounds(fb);
+#ifdef PBL_COLOR
+    int size = 0;
+    for (int y = 0; y < bounds.size.h; y++) {
+        GBitmapDataRowInfo info = gbitmap_get_data_row_info(fb, y);
+        size += info.max_x - info.min_x + 1;
+    }
+    return size;
+#else
+    return bounds.size.h * gbitmap_get_bytes_per_row(fb);
+#endif
+}
+
+// Draws the static part of the face: background and emblem.
+// It is composited once and then restored from the cache on every redraw until the theme changes.
+// Without memory for the cache it is drawn directly every time.
+static void background_update_proc(Layer *layer, GContext *ctx) {
+    GBitmap *fb;
+
+    if (s_background_cache) {
+        fb = graphics_capture_frame_buffer(ctx);
+        if (fb) {
+            copy_framebuffer(fb, s_background_cache, false);
+            graphics_release_frame_buffer(ctx, fb);
+            return;
+        }
+    }
+
     GRect bounds = layer_get_bounds(layer);
-    graphics_context_set_fill_color(ctx, GColorBlack);    
-    graphics_fill_rect(ctx, bounds, 8, GCornersAll);
+    graphics_context_set_fill_color(ctx, s_background_color);
+    graphics_fill_rect(ctx, bounds, 0, GCornerNone);
+
+    // Emblem centered as the bitmap layer used to do
+    GRect emblem_bounds = gbitmap_get_bounds(s_background_bitmap);
+    graphics_draw_bitmap_in_rect(ctx, s_background_bitmap, GRect((bounds.size.w - emblem_bounds.size.w) / 2, (bounds.size.h - emblem_bounds.size.h) / 2, emblem_bounds.size.w, emblem_bounds.size.h));
+
+    if (s_background_cache_failed) {
+        return;
+    }
+    fb = graphics_capture_frame_buffer(ctx);
+    if (fb) {
+        s_background_cache = malloc(framebuffer_cache_size(fb));
+        if (s_background_cache) {
+            copy_framebuffer(fb, s_background_cache, true);
+        } else {
+            s_background_cache_failed = true;
+        }
+        graphics_release_frame_buffer(ctx, fb);
+    }
 }
 
 static void battery_callback(BatteryChargeState state) {
     layer_set_hidden(bitmap_layer_get_layer(s_charge_icon_layer), !state.is_charging);
+
+    // Every redraw re-renders the whole window (background restored from cache, text redrawn), so skip it if the bar would not change
+    if (state.charge_percent == s_battery_level) {
+        return;
+    }
     s_battery_level = state.charge_percent;
     layer_mark_dirty(s_battery_layer);
 }
@@ -140,11 +281,11 @@ static void main_window_load(Window *window) {
     Layer *window_layer = window_get_root_layer(window);
     GRect bounds = layer_get_bounds(window_layer);
 
-    // Show bitmap
+    // Show static background (emblem)
     s_background_bitmap = gbitmap_create_with_resource(RESOURCE_ID_QROW_EMBLEM);
-    s_background_layer = bitmap_layer_create(bounds);
-    bitmap_layer_set_bitmap(s_background_layer, s_background_bitmap);
-    layer_add_child(window_layer, bitmap_layer_get_layer(s_background_layer));
+    s_background_layer = layer_create(bounds);
+    layer_set_update_proc(s_background_layer, background_update_proc);
+    layer_add_child(window_layer, s_background_layer);
 
     // Create fonts
     s_rwby_time_font = fonts_load_custom_font(resource_get_handle(RESOURCE_ID_RWBY_TIME_FONT_48));
@@ -173,11 +314,8 @@ static void main_window_load(Window *window) {
     text_layer_set_text_alignment(s_date_layer, GTextAlignmentCenter);
     layer_add_child(window_layer, text_layer_get_layer(s_date_layer));
 
-    // Show battery
-    s_battery_background_layer = layer_create(GRect(PBL_IF_ROUND_ELSE(24, 14), PBL_IF_ROUND_ELSE(135, 130), bounds.size.w - PBL_IF_ROUND_ELSE(48, 28), 6));
-    layer_set_update_proc(s_battery_background_layer, battery_background_update_proc);
-    layer_add_child(window_get_root_layer(window), s_battery_background_layer);
-    s_battery_layer = layer_create(GRect(PBL_IF_ROUND_ELSE(25, 15), PBL_IF_ROUND_ELSE(136, 131), bounds.size.w - PBL_IF_ROUND_ELSE(50, 30), 4));
+    // Show battery (frame and bar, above the text as before)
+    s_battery_layer = layer_create(GRect(PBL_IF_ROUND_ELSE(24, 14), PBL_IF_ROUND_ELSE(135, 130), bounds.size.w - PBL_IF_ROUND_ELSE(48, 28), 6));
     layer_set_update_proc(s_battery_layer, battery_update_proc);
     layer_add_child(window_layer, s_battery_layer);
 
@@ -194,11 +332,9 @@ static void main_window_load(Window *window) {
     bitmap_layer_set_bitmap(s_charge_icon_layer, s_charge_icon_bitmap);
     layer_add_child(window_layer, bitmap_layer_get_layer(s_charge_icon_layer));
 
-    // Setup inverting layer
-    s_effect_layer = effect_layer_create(GRect(0, 0, bounds.size.w, bounds.size.h));
-    effect_layer_add_effect(s_effect_layer, effect_invert, NULL);
-    layer_add_child(window_layer, effect_layer_get_layer(s_effect_layer));
-    layer_set_hidden(effect_layer_get_layer(s_effect_layer), settings.LightTheme);
+    // Color everything for the current theme (bitmaps were just loaded, so not inverted yet)
+    s_bitmaps_inverted = false;
+    apply_theme();
 }
 
 static void main_window_unload(Window *window) {
@@ -209,14 +345,14 @@ static void main_window_unload(Window *window) {
     fonts_unload_custom_font(s_rwby_time_font);
     fonts_unload_custom_font(s_rwby_date_font);
     gbitmap_destroy(s_background_bitmap);
-    bitmap_layer_destroy(s_background_layer);
+    layer_destroy(s_background_layer);
+    free(s_background_cache);
+    s_background_cache = NULL;
     layer_destroy(s_battery_layer);
-    layer_destroy(s_battery_background_layer);
     gbitmap_destroy(s_bt_icon_bitmap);
     bitmap_layer_destroy(s_bt_icon_layer);
     gbitmap_destroy(s_charge_icon_bitmap);
     bitmap_layer_destroy(s_charge_icon_layer);
-    effect_layer_destroy(s_effect_layer);
 }
 
 static void init() {
@@ -225,7 +361,6 @@ static void init() {
 
     // Create main Window
     s_main_window = window_create();
-    window_set_background_color(s_main_window, GColorWhite);
 
     // Set handlers to manage the elements inside the Window
     window_set_window_handlers(s_main_window, (WindowHandlers) {
@@ -1,142 +1,120 @@
-//Taken from Michael Ehrmann source code of SunClock https://github.com/mehrmann/pebble-sunclock
+#include <pebble.h>
 #include "math.h"
 
-/* 
- * loosely based on 
- * - http://stackoverflow.com/questions/11261170/c-and-maths-fast-approximation-of-a-trigonometric-function
- * - http://www.codeproject.com/Articles/69941/Best-Square-Root-Method-Algorithm-Function-Precisi
- */
+// asin(i/256) for i = 0..128, in quarters of TRIG_MAX_ANGLE units (rounded only once the result is complete)
+static const uint16_t s_asin_table[129] = {
+  0, 163, 326, 489, 652, 815, 978, 1141, 1304, 1467, 1630, 1793, 1956, 2120, 2283, 2446,
+  2609, 2773, 2936, 3099, 3263, 3426, 3590, 3753, 3917, 4081, 4245, 4409, 4572, 4736, 4901, 5065,
+  5229, 5393, 5558, 5722, 5887, 6051, 6216, 6381, 6546, 6711, 6876, 7041, 7207, 7372, 7538, 7704,
+  7869, 8035, 8201, 8368, 8534, 8701, 8867, 9034, 9201, 9368, 9535, 9703, 9870, 10038, 10206, 10374,
+  10542, 10711, 10879, 11048, 11217, 11386, 11555, 11725, 11895, 12065, 12235, 12405, 12576, 12746, 12917, 13089,
+  13260, 13432, 13604, 13776, 13948, 14121, 14294, 14467, 14640, 14814, 14988, 15162, 15337, 15512, 15687, 15862,
+  16038, 16214, 16390, 16566, 16743, 16920, 17098, 17276, 17454, 17633, 17811, 17991, 18170, 18350, 18530, 18711,
+  18892, 19074, 19255, 19438, 19620, 19803, 19987, 20171, 20355, 20540, 20725, 20910, 21096, 21283, 21470, 21657,
+  21845
+};
 
-#define SQRT_MAGIC_F 0x5f3759df 
-float my_sqrt(const float x)
-{
-  const float xhalf = 0.5f*x;
- 
-  union // get bits for floating value
-  {
-    float x;
-    int i;
-  } u;
-  u.x = x;
-  u.i = SQRT_MAGIC_F - (u.i >> 1);  // gives initial guess y0
-  return x*u.x*(1.5f - xhalf*u.x*u.x);// Newton step, repeating increases accuracy 
-}   
+// atan(i/256) for i = 0..256, in quarters of TRIG_MAX_ANGLE units
+static const uint16_t s_atan_table[257] = {
+  0, 163, 326, 489, 652, 815, 978, 1141, 1303, 1466, 1629, 1792, 1954, 2117, 2279, 2442,
+  2604, 2767, 2929, 3091, 3253, 3415, 3577, 3738, 3900, 4061, 4223, 4384, 4545, 4706, 4867, 5028,
+  5188, 5349, 5509, 5669, 5829, 5989, 6148, 6308, 6467, 6626, 6784, 6943, 7101, 7260, 7418, 7575,
+  7733, 7890, 8047, 8204, 8361, 8517, 8673, 8829, 8985, 9140, 9296, 9450, 9605, 9759, 9914, 10067,
+  10221, 10374, 10527, 10680, 10832, 10984, 11136, 11287, 11439, 11590, 11740, 11890, 12040, 12190, 12339, 12488,
+  12637, 12785, 12933, 13081, 13228, 13375, 13522, 13668, 13814, 13959, 14105, 14249, 14394, 14538, 14682, 14825,
+  14968, 15111, 15253, 15395, 15537, 15678, 15819, 15960, 16100, 16239, 16379, 16518, 16656, 16794, 16932, 17069,
+  17206, 17343, 17479, 17615, 17750, 17885, 18020, 18154, 18288, 18421, 18554, 18687, 18819, 18951, 19083, 19213,
+  19344, 19474, 19604, 19733, 19862, 19991, 20119, 20247, 20374, 20501, 20627, 20753, 20879, 21004, 21129, 21254,
+  21378, 21501, 21624, 21747, 21870, 21992, 22113, 22234, 22355, 22475, 22595, 22714, 22834, 22952, 23070, 23188,
+  23306, 23423, 23539, 23655, 23771, 23886, 24001, 24116, 24230, 24344, 24457, 24570, 24682, 24795, 24906, 25017,
+  25128, 25239, 25349, 25459, 25568, 25677, 25785, 25893, 26001, 26108, 26215, 26321, 26427, 26533, 26638, 26743,
+  26848, 26952, 27056, 27159, 27262, 27364, 27467, 27568, 27670, 27771, 27871, 27972, 28072, 28171, 28270, 28369,
+  28467, 28565, 28663, 28760, 28857, 28953, 29050, 29145, 29241, 29336, 29430, 29525, 29619, 29712, 29805, 29898,
+  29991, 30083, 30175, 30266, 30357, 30448, 30538, 30628, 30718, 30807, 30896, 30985, 31073, 31161, 31248, 31336,
+  31423, 31509, 31595, 31681, 31767, 31852, 31937, 32022, 32106, 32190, 32273, 32357, 32439, 32522, 32604, 32686,
+  32768
+};
 
-float my_floor(float x) 
-{
-  return ((int)x);
+// table entry for x with 1/256 steps and "bits" bits below them (8 for Q16), interpolated between neighbours
+static int32_t fx_lookup(const uint16_t *table, int last, int32_t x, int bits) {
+  int i = x >> bits;
+  if (i >= last) return table[last];
+  return table[i] + (((table[i + 1] - table[i]) * (x & ((1 << bits) - 1)) + (1 << (bits - 1))) >> bits);
 }
 
-float my_fabs(float x)
-{
-  if (x<0) return -x;
-  return x;
-}
-
-float my_atan(float x)
-{
-  if (x>0) 
-  {
-    return (M_PI/2)*(0.596227*x + x*x)/(1 + 2*0.596227*x + x*x);
-  } 
-  else
-  {
-    return -(my_atan(-x));
+// bit by bit square root, one result bit per step without branching on the data
+uint32_t fx_sqrt(uint32_t x) {
+  if (x == 0) return 0;
+  uint32_t root = 0, bit = 1u << ((31 - __builtin_clz(x)) & ~1);
+  while (bit) {
+    uint32_t trial = root + bit;
+    uint32_t taken = -(uint32_t)(x >= trial);
+    x -= trial & taken;
+    root = (root >> 1) + (bit & taken);
+    bit >>= 2;
   }
+  return root;
 }
 
-/* not quite rint(), i.e. results not properly rounded to nearest-or-even */
-float my_rint (float x)
-{
-  float t = my_floor (my_fabs(x) + 0.5);
-  return (x < 0.0) ? -t : t;
-}
-
-/* minimax approximation to cos on [-pi/4, pi/4] with rel. err. ~= 7.5e-13 */
-float cos_core (float x)
-{
-  float x8, x4, x2;
-  x2 = x * x;
-  x4 = x2 * x2;
-  x8 = x4 * x4;
-  /* evaluate polynomial using Estrin's scheme */
-  return (-2.7236370439787708e-7 * x2 + 2.4799852696610628e-5) * x8 +
-         (-1.3888885054799695e-3 * x2 + 4.1666666636943683e-2) * x4 +
-         (-4.9999999999963024e-1 * x2 + 1.0000000000000000e+0);
-}
-
-/* minimax approximation to sin on [-pi/4, pi/4] with rel. err. ~= 5.5e-12 */
-float sin_core (float x)
-{
-  float x4, x2;
-  x2 = x * x;
-  x4 = x2 * x2;
-  /* evaluate polynomial using a mix of Estrin's and Horner's scheme */
-  return ((2.7181216275479732e-6 * x2 - 1.9839312269456257e-4) * x4 + 
-          (8.3333293048425631e-3 * x2 - 1.6666666640797048e-1)) * x2 * x + x;
-}
-
-/* minimax approximation to arcsin on [0, 0.5625] with rel. err. ~= 1.5e-11 */
-float asin_core (float x)
-{
-  float x8, x4, x2;
-  x2 = x * x;
-  x4 = x2 * x2;
-  x8 = x4 * x4;
-  /* evaluate polynomial using a mix of Estrin's and Horner's scheme */
-  return (((4.5334220547132049e-2 * x2 - 1.1226216762576600e-2) * x4 +
-           (2.6334281471361822e-2 * x2 + 2.0596336163223834e-2)) * x8 +
-          (3.0582043602875735e-2 * x2 + 4.4630538556294605e-2) * x4 +
-          (7.5000364034134126e-2 * x2 + 1.6666666300567365e-1)) * x2 * x + x; 
-}
-
-/* relative error < 7e-12 on [-50000, 50000] */
-float my_sin (float x)
-{
-  float q, t;
-  int quadrant;
-  /* Cody-Waite style argument reduction */
-  q = my_rint (x * 6.3661977236758138e-1);
-  quadrant = (int)q;
-  t = x - q * 1.5707963267923333e+00;
-  t = t - q * 2.5633441515945189e-12;
-  if (quadrant & 1) {
-    t = cos_core(t);
+int32_t fx_asin(int32_t x) {
+  if (x > FX_ONE) x = FX_ONE;
+  if (x < -FX_ONE) x = -FX_ONE; // before negating: -INT32_MIN overflows
+  int32_t xa = x < 0 ? -x : x;
+  
+  int32_t angle;
+  if (xa <= FX_ONE / 2) {
+    angle = fx_lookup(s_asin_table, 128, xa, 8);
   } else {
-    t = sin_core(t);
+    // asin gets steep towards 1: asin(x) = pi/2 - 2 * asin(sqrt((1-x) / 2)), sqrt taken in Q17 for the extra bit
+    angle = TRIG_MAX_ANGLE - 2 * fx_lookup(s_asin_table, 128, fx_sqrt((uint32_t)(FX_ONE - xa) << 17), 9);
   }
-  return (quadrant & 2) ? -t : t;
+  angle = (angle + 2) >> 2;
+  return x < 0 ? -angle : angle;
 }
 
-float my_cos(float x)
-{
-  return my_sin(x + (M_PI/2));
+int32_t fx_acos(int32_t x) {
+  return TRIG_MAX_ANGLE / 4 - fx_asin(x);
 }
 
-/* relative error < 2e-11 on [-1, 1] */
-float my_acos (float x)
-{
-  float xa, t;
-  xa = my_fabs (x);
-  /* arcsin(x) = pi/2 - 2 * arcsin (sqrt ((1-x) / 2)) 
-   * arccos(x) = pi/2 - arcsin(x)
-   * arccos(x) = 2 * arcsin (sqrt ((1-x) / 2))
-   */
-  if (xa > 0.5625) {
-    t = 2.0 * asin_core (my_sqrt (0.5 * (1.0 - xa)));
-  } else {
-    t = 1.5707963267948966 - asin_core (xa);
+int32_t fx_atan(int32_t x) {
+  if (x == INT32_MIN) x = -INT32_MAX; // -INT32_MIN overflows, atan is flat out there anyway
+  int32_t xa = x < 0 ? -x : x;
+  
+  int32_t angle;
+  if (xa <= FX_ONE) {
+    angle = fx_lookup(s_atan_table, 256, xa, 8);
+  } else { // atan(x) = pi/2 - atan(1/x)
+    angle = TRIG_MAX_ANGLE - fx_lookup(s_atan_table, 256, ((int64_t)FX_ONE * FX_ONE) / xa, 8);
   }
-  /* arccos (-x) = pi - arccos(x) */
-  return (x < 0.0) ? (3.1415926535897932 - t) : t;
+  angle = (angle + 2) >> 2;
+  return x < 0 ? -angle : angle;
 }
 
-float my_asin (float x)
-{
-  return (M_PI/2) - my_acos(x);
+// tan of an angle within FX_TAN_SERIES of 0 in Q32, from tan(b) = b + b^3/3 + 2b^5/15 with b in radians
+#define FX_TAN_SERIES (TRIG_MAX_ANGLE / 64)
+static int64_t fx_tan_series(int32_t angle) {
+  int64_t b = ((int64_t)angle * 26986075409LL) >> 16; // 2 pi in Q32
+  int64_t b2 = (b * b) >> 32, b3 = (b2 * b) >> 32, b5 = (b3 * b2) >> 32;
+  return b + b3 / 3 + 2 * b5 / 15;
 }
 
-float my_tan(float x)
-{
-  return my_sin(x) / my_cos(x);
-}
\ No newline at end of file
+// sin/cos lookups have too few bits near 0 and 90 deg (cos of 89.99 deg is 6/65535), the series covers those
+int32_t fx_tan(int32_t angle) {
+  int32_t sin = sin_lookup(angle), cos = cos_lookup(angle);
+  if (cos == 0) return sin < 0 ? INT32_MIN : INT32_MAX;
+  
+  int32_t a = angle & (TRIG_MAX_ANGLE / 2 - 1); // tan repeats every half turn, a is in -90..90 deg
+  if (a > TRIG_MAX_ANGLE / 4) a -= TRIG_MAX_ANGLE / 2;
+  if (a >= -FX_TAN_SERIES && a <= FX_TAN_SERIES) return (fx_tan_series(a) + (1 << 15)) >> 16;
+  int32_t to_right = TRIG_MAX_ANGLE / 4 - (a < 0 ? -a : a);
+  if (to_right == 0) return a < 0 ? INT32_MIN : INT32_MAX; // whatever cos_lookup gives at exactly 90 deg
+  if (to_right <= FX_TAN_SERIES) { // tan(90 deg - b) = 1 / tan(b), at most 2^48 / tan of 1 angle unit (under 2^30)
+    int64_t tan = ((int64_t)1 << 48) / fx_tan_series(to_right);
+    return a < 0 ? -tan : tan;
+  }
+  
+  int64_t tan = (int64_t)sin * FX_ONE / cos;
+  if (tan > INT32_MAX) return INT32_MAX;
+  if (tan < INT32_MIN) return INT32_MIN;
+  return tan;
+}
@@ -1,14 +1,12 @@
-//Taken from Michael Ehrmann source code of SunClock https://github.com/mehrmann/pebble-sunclock
 #pragma once
+#include <stdint.h>
 
-#define M_PI 3.141592653589793
-float my_sqrt(const float x);
-float my_floor(float x); 
-float my_fabs(float x);
-float my_atan(float x);
-float my_rint (float x);
-float my_sin (float x);
-float my_cos(float x);
-float my_acos (float x);
-float my_asin (float x);
-float my_tan(float x);
\ No newline at end of file
+// Fixed point math, no floats: ratios are Q16 (FX_ONE is 1.0), angles are in Pebble units (TRIG_MAX_ANGLE is a full
+// turn) so results go straight to sin_lookup/cos_lookup. Tables are interpolated linearly; errors measured against
+// libm over the whole input range (make -C test math-bench).
+#define FX_ONE 0x10000
+uint32_t fx_sqrt(uint32_t x);  // floor(sqrt(x)), exact
+int32_t fx_asin(int32_t x);    // x in [-FX_ONE, FX_ONE] (clamped), error under 1.2 angle units (0.007 deg)
+int32_t fx_acos(int32_t x);    // x in [-FX_ONE, FX_ONE] (clamped), error under 1.2 angle units
+int32_t fx_atan(int32_t x);    // any x, error under 1 angle unit
+int32_t fx_tan(int32_t angle); // error under 1e-4 (relative beyond 45 deg), INT32_MAX / INT32_MIN at +-90 deg
@@ -0,0 +1,261 @@
+// Host benchmark of the effect library: times every effect on the fixture scene (restored before every frame) at a
+// full screen, half screen and 32x32 rect, and prints the median time per frame and per pixel as CSV or JSON. These
+// are host times - use them to compare builds of the library with each other (make bench BASELINE=<git ref>), not as
+// watch timings.
+//   bench [--json] [--baseline <csv>] [case...]   --baseline adds the frame times of an earlier CSV run and the
+//                                                 speedup over them
+#include <pebble.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "effects.h"
+#include "fixture.h"
+
+#define MIN_FRAMES 20
+#define MAX_FRAMES 5000
+#define MIN_TOTAL_NS 50000000 // keep timing until this much has been measured
+
+// effects the original library does not have, NULL when the bench is linked against it
+#pragma weak effect_palette_map
+#pragma weak effect_affine
+#pragma weak effect_affine_rotate_scale
+
+typedef struct {
+  const char *name;
+  effect_cb *effect;
+  void *param;
+} BenchEffect;
+
+typedef struct {
+  const char *name;
+  effect_cb *effect;
+  void *param;
+  GRect rect;
+} BenchCase;
+
+static uint8_t s_channel_rotation[256];
+static EffectColorpair s_black_to_red = { GColorBlack, GColorRed };
+static EffectColorpair s_black_white = { GColorBlack, GColorWhite };
+static EffectAffine s_affine;
+static GColor s_mask_colors[] = { GColorBlack, GColorClear };
+static EffectMask s_mask_text = { .mask_colors = s_mask_colors, .background_color = GColorClear, .text = "10:08",
+                                  .text_overflow = GTextOverflowModeWordWrap, .text_align = GTextAlignmentCenter };
+static EffectMask s_mask_bitmap = { .mask_colors = s_mask_colors, .background_color = GColorClear };
+static EffectOffset s_shadow = { .orig_color = GColorBlack, .offset_color = GColorRed, .offset_x = 3, .offset_y = 2 };
+static uint8_t s_aplite_visited[20 * 168]; // for long shadow in the original library, zeroed before each frame
+static EffectOffset s_long_shadow = { .orig_color = GColorBlack, .offset_color = GColorDarkGray, .offset_x = 8, .offset_y = 5,
+                                      .option = 1, .aplite_visited = s_aplite_visited };
+static EffectOffset s_outline = { .orig_color = GColorBlack, .offset_color = GColorRed, .offset_x = 2, .offset_y = 1 };
+
+static BenchEffect s_effects[] = {
+  { "invert", effect_invert, NULL },
+  { "invert_bw_only", effect_invert_bw_only, NULL },
+  { "invert_brightness", effect_invert_brightness, NULL },
+  { "palette_map", NULL, s_channel_rotation }, // set in main, the effect may be missing
+  { "colorize", effect_colorize, &s_black_to_red },
+  { "colorswap", effect_colorswap, &s_black_white },
+  { "mirror_vertical", effect_mirror_vertical, NULL },
+  { "mirror_horizontal", effect_mirror_horizontal, NULL },
+  { "rotate", effect_rotate_90_degrees, (void *)true },
+  { "blur_1", effect_blur, (void *)1 },
+  { "blur_4", effect_blur, (void *)4 },
+  { "zoom", effect_zoom, EL_ZOOM(150, 200) },
+  { "affine", NULL, &s_affine }, // set in main
+  { "lens", effect_lens, EL_LENS(80, 30) },
+  { "mask_text", effect_mask, &s_mask_text },
+  { "mask_bitmap", effect_mask, &s_mask_bitmap },
+  { "shadow", effect_shadow, &s_shadow },
+  { "long_shadow", effect_shadow, &s_long_shadow },
+  { "outline", effect_outline, &s_outline },
+};
+
+static const GRect s_rects[] = {
+  {{0, 0}, {W, H}},
+  {{W / 4, H / 4}, {W / 2, H / 2}},
+  {{W / 2 - 16, H / 2 - 16}, {32, 32}},
+};
+
+//  ********* baseline *********
+
+typedef struct {
+  char name[64];
+  int w, h;
+  double ns_per_frame;
+} BaselineRow;
+
+static BaselineRow *s_baseline;
+static int s_baseline_count;
+
+// rows of an earlier bench run, as printed by print_row
+static bool read_baseline(const char *path) {
+  FILE *file = fopen(path, "r");
+  if (!file) return false;
+  char line[256];
+  while (fgets(line, sizeof(line), file)) {
+    BaselineRow row;
+    if (sscanf(line, "%*[^,],%63[^,],%d,%d,%*d,%*d,%lf", row.name, &row.w, &row.h, &row.ns_per_frame) != 4) continue;
+    s_baseline = realloc(s_baseline, (s_baseline_count + 1) * sizeof(BaselineRow));
+    s_baseline[s_baseline_count++] = row;
+  }
+  fclose(file);
+  return true;
+}
+
+static double baseline_ns_per_frame(const BenchCase *bench) {
+  for (int i = 0; i < s_baseline_count; i++)
+    if (strcmp(s_baseline[i].name, bench->name) == 0 && s_baseline[i].w == bench->rect.size.w && s_baseline[i].h == bench->rect.size.h)
+      return s_baseline[i].ns_per_frame;
+  return 0;
+}
+
+//  ********* timing *********
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static int compare_times(const void *a, const void *b) {
+  uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+  return (x > y) - (x < y);
+}
+
+// median time of one frame; every frame starts from the same scene
+static uint64_t time_case(const BenchCase *bench, GBitmap *fb, GContext *ctx, const uint8_t *scene, int *frames) {
+  static uint64_t times[MAX_FRAMES];
+  size_t size = host_framebuffer_size(fb);
+  uint64_t total = 0;
+  int n = 0;
+  while (n < MAX_FRAMES && (n < MIN_FRAMES || total < MIN_TOTAL_NS)) {
+    memcpy(gbitmap_get_data(fb), scene, size);
+    memset(s_aplite_visited, 0, sizeof(s_aplite_visited));
+    host_context_set_origin(ctx, bench->rect.origin);
+    uint64_t start = now_ns();
+    bench->effect(ctx, bench->rect, bench->param);
+    times[n] = now_ns() - start;
+    total += times[n++];
+  }
+  qsort(times, n, sizeof(times[0]), compare_times);
+  *frames = n;
+  return times[n / 2];
+}
+
+// pixels of the rect that are on screen
+static int rect_pixels(GRect rect) {
+  int w = (rect.origin.x + rect.size.w < W ? rect.origin.x + rect.size.w : W) - (rect.origin.x > 0 ? rect.origin.x : 0);
+  int h = (rect.origin.y + rect.size.h < H ? rect.origin.y + rect.size.h : H) - (rect.origin.y > 0 ? rect.origin.y : 0);
+  return w > 0 && h > 0 ? w * h : 0;
+}
+
+static bool s_json;
+static int s_rows;
+
+// CSV row, or JSON object with null for missing values; frames is 0 for a case that failed
+static void print_row(const BenchCase *bench, int frames, double ns_per_frame) {
+  int pixels = rect_pixels(bench->rect);
+  double baseline = s_baseline ? baseline_ns_per_frame(bench) : 0;
+  if (s_json) {
+    printf("%s\n  {\"platform\": \"%s\", \"case\": \"%s\", \"w\": %d, \"h\": %d, \"pixels\": %d, \"frames\": %d",
+           s_rows ? "," : "[", PLATFORM_NAME, bench->name, bench->rect.size.w, bench->rect.size.h, pixels, frames);
+    if (frames) printf(", \"ns_per_frame\": %.0f, \"ns_per_pixel\": %.3f", ns_per_frame, pixels ? ns_per_frame / pixels : 0);
+    else printf(", \"ns_per_frame\": null, \"ns_per_pixel\": null");
+    if (s_baseline && baseline > 0) printf(", \"baseline_ns_per_frame\": %.0f", baseline);
+    else if (s_baseline) printf(", \"baseline_ns_per_frame\": null");
+    if (s_baseline && baseline > 0 && frames) printf(", \"speedup\": %.2f}", baseline / ns_per_frame);
+    else if (s_baseline) printf(", \"speedup\": null}");
+    else printf("}");
+  } else {
+    printf("%s,%s,%d,%d,%d,%d,", PLATFORM_NAME, bench->name, bench->rect.size.w, bench->rect.size.h, pixels, frames);
+    if (frames) printf("%.0f,%.3f", ns_per_frame, pixels ? ns_per_frame / pixels : 0);
+    else printf("failed,");
+    if (s_baseline) {
+      printf(",");
+      if (baseline > 0) printf("%.0f", baseline);
+      printf(",");
+      if (baseline > 0 && frames) printf("%.2f", baseline / ns_per_frame);
+    }
+    printf("\n");
+  }
+  s_rows++;
+}
+
+// runs in a child process, so one that crashes (the original library releases the framebuffer twice in some
+// effects) gives a failed row instead of ending the run
+static void run_case(const BenchCase *bench, GBitmap *fb, GContext *ctx, const uint8_t *scene) {
+  int pipe_fds[2];
+  if (pipe(pipe_fds) != 0) return;
+  fflush(stdout);
+  pid_t pid = fork();
+  if (pid == 0) {
+    close(pipe_fds[0]);
+    int frames = 0;
+    uint64_t median = time_case(bench, fb, ctx, scene, &frames);
+    uint64_t result[2] = { median, frames };
+    if (write(pipe_fds[1], result, sizeof(result)) != sizeof(result)) _exit(1);
+    _exit(0);
+  }
+  close(pipe_fds[1]);
+  uint64_t result[2] = { 0, 0 };
+  int status = 0;
+  bool ok = read(pipe_fds[0], result, sizeof(result)) == sizeof(result);
+  close(pipe_fds[0]);
+  waitpid(pid, &status, 0);
+  ok &= WIFEXITED(status) && WEXITSTATUS(status) == 0;
+  print_row(bench, ok ? (int)result[1] : 0, (double)result[0]);
+}
+
+int main(int argc, char **argv) {
+  int first_name = 1;
+  if (first_name < argc && strcmp(argv[first_name], "--json") == 0) {
+    s_json = true;
+    first_name++;
+  }
+  if (first_name + 1 < argc && strcmp(argv[first_name], "--baseline") == 0) {
+    if (!read_baseline(argv[first_name + 1])) {
+      fprintf(stderr, "cannot read %s\n", argv[first_name + 1]);
+      return 2;
+    }
+    first_name += 2;
+  }
+
+  for (int c = 0; c < 256; c++) s_channel_rotation[c] = (c & 0xC0) | ((c & 0x03) << 4) | ((c & 0x3C) >> 2);
+  if (effect_affine_rotate_scale) {
+    effect_affine_rotate_scale(&s_affine, TRIG_MAX_ANGLE / 12, 0x14000);
+    s_affine.background_color = GColorBlue;
+  }
+  for (size_t e = 0; e < sizeof(s_effects) / sizeof(s_effects[0]); e++) {
+    if (strcmp(s_effects[e].name, "palette_map") == 0) s_effects[e].effect = effect_palette_map;
+    if (strcmp(s_effects[e].name, "affine") == 0) s_effects[e].effect = effect_affine;
+  }
+  s_mask_text.bitmap_background = s_mask_bitmap.bitmap_background = create_pattern_bitmap(GSize(W, H), GColorWhite, GColorBlue);
+  s_mask_bitmap.bitmap_mask = create_pattern_bitmap(GSize(20, 20), GColorClear, GColorBlack);
+
+  GBitmap *fb = host_framebuffer_create();
+  GContext *ctx = host_context_create(fb);
+  draw_fixture(ctx);
+  size_t size = host_framebuffer_size(fb);
+  uint8_t *scene = malloc(size);
+  memcpy(scene, gbitmap_get_data(fb), size);
+
+  if (!s_json) printf("platform,case,w,h,pixels,frames,ns_per_frame,ns_per_pixel%s\n", s_baseline ? ",baseline_ns_per_frame,speedup" : "");
+  for (size_t e = 0; e < sizeof(s_effects) / sizeof(s_effects[0]); e++) {
+    const BenchEffect *effect = &s_effects[e];
+    bool selected = first_name >= argc;
+    for (int a = first_name; a < argc; a++) selected |= strcmp(argv[a], effect->name) == 0;
+    if (!selected || !effect->effect) continue;
+    for (size_t r = 0; r < sizeof(s_rects) / sizeof(s_rects[0]); r++) {
+      BenchCase bench = { effect->name, effect->effect, effect->param, s_rects[r] };
+      run_case(&bench, fb, ctx, scene);
+    }
+  }
+  if (s_json) printf("%s\n]\n", s_rows ? "" : "[");
+
+  gbitmap_destroy(s_mask_text.bitmap_background);
+  gbitmap_destroy(s_mask_bitmap.bitmap_mask);
+  free(scene);
+  free(s_baseline);
+  host_context_destroy(ctx);
+  gbitmap_destroy(fb);
+  return 0;
+}
@@ -0,0 +1,424 @@
+// Golden-image tests of the effect library: every case draws the same fixture scene, runs effects on it and
+// compares the framebuffer byte for byte with test/golden/<platform>/<case>.fb. Cases run twice on a fresh
+// fixture so cached tables (lens, zoom, mask) are checked on reuse as well.
+//   effects_test <golden dir> [case...]            compare (all cases, or just the named ones)
+//   effects_test <golden dir> --update [case...]   (re)write golden images
+#include <pebble.h>
+#include "effects.h"
+#include "effect_layer.h"
+#include "fixture.h"
+
+//  ********* cases *********
+
+typedef struct {
+  const char *name;
+  effect_cb *effect; // run on rect with param, unless run is set
+  void *param;
+  GRect rect;
+  void (*run)(GContext *ctx);
+} TestCase;
+
+static uint8_t s_channel_rotation[256];
+static EffectColorpair s_black_to_red = { GColorBlack, GColorRed };
+static EffectColorpair s_black_white = { GColorBlack, GColorWhite };
+static EffectOffset s_shadow = { .orig_color = GColorBlack, .offset_color = GColorRed, .offset_x = 3, .offset_y = 2 };
+static EffectOffset s_shadow_same = { .orig_color = GColorBlack, .offset_color = GColorBlack, .offset_x = 2, .offset_y = 1 };
+static EffectOffset s_long_shadow = { .orig_color = GColorBlack, .offset_color = GColorDarkGray, .offset_x = 8, .offset_y = 5,
+                                      .option = 1 };
+static EffectOffset s_long_shadow_up = { .orig_color = GColorBlack, .offset_color = GColorWhite, .offset_x = -3, .offset_y = -9,
+                                         .option = 1 };
+static EffectOffset s_outline = { .orig_color = GColorBlack, .offset_color = GColorRed, .offset_x = 2, .offset_y = 1 };
+static EffectAffine s_affine;
+
+static GColor s_mask_colors[] = { GColorBlack, GColorClear };
+
+#define MASK_RECT GRect(12, 80, W - 24, 60)
+
+// text mask when mask_bitmap is NULL
+static void run_mask(GContext *ctx, GRect rect, GBitmap *mask_bitmap) {
+  GBitmap *background = create_pattern_bitmap(GSize(rect.size.w, rect.size.h), GColorWhite, GColorBlue);
+  EffectMask mask = {
+    .bitmap_mask = mask_bitmap, .bitmap_background = background, .mask_colors = s_mask_colors, .background_color = GColorClear,
+    .text = mask_bitmap ? NULL : "10:08", .font = NULL, .text_overflow = GTextOverflowModeWordWrap, .text_align = GTextAlignmentCenter,
+  };
+  host_context_set_origin(ctx, rect.origin);
+  effect_mask(ctx, rect, &mask);
+  gbitmap_destroy(background);
+}
+
+static void run_mask_text(GContext *ctx) { run_mask(ctx, MASK_RECT, NULL); }
+
+static void run_mask_bitmap(GContext *ctx) {
+  GBitmap *mask_bitmap = create_pattern_bitmap(GSize(20, 20), GColorClear, GColorBlack);
+  run_mask(ctx, MASK_RECT, mask_bitmap);
+  gbitmap_destroy(mask_bitmap);
+}
+
+// mask colors changed in place (same array, same bitmap) must not reuse the coverage of the old ones
+static void run_mask_recolored(GContext *ctx) {
+  static GBitmap *mask_bitmap;
+  if (!mask_bitmap) mask_bitmap = create_pattern_bitmap(GSize(20, 20), GColorWhite, GColorBlack);
+  run_mask(ctx, MASK_RECT, mask_bitmap);
+  s_mask_colors[0] = GColorWhite;
+  draw_fixture(ctx);
+  run_mask(ctx, MASK_RECT, mask_bitmap);
+  s_mask_colors[0] = GColorBlack;
+}
+
+// mask bitmap changed after the mask was cached: pixels drawn into it (with effect_mask_invalidate), or its bounds
+static void run_mask_bitmap_changed(GContext *ctx, bool pixels) {
+  GBitmap *mask_bitmap = create_pattern_bitmap(GSize(20, 20), GColorWhite, GColorBlack);
+  run_mask(ctx, MASK_RECT, mask_bitmap);
+  draw_fixture(ctx);
+  if (pixels) {
+    uint8_t *data = gbitmap_get_data(mask_bitmap);
+    for (int i = 0; i < gbitmap_get_bytes_per_row(mask_bitmap) * 20; i++) data[i] ^= PBL_IF_COLOR_ELSE(0x3F, 0xFF); // white <-> black
+    effect_mask_invalidate();
+  } else {
+    gbitmap_set_bounds(mask_bitmap, GRect(0, 0, 12, 12));
+  }
+  run_mask(ctx, MASK_RECT, mask_bitmap);
+  gbitmap_destroy(mask_bitmap);
+}
+
+static void run_mask_bitmap_invalidated(GContext *ctx) { run_mask_bitmap_changed(ctx, true); }
+static void run_mask_bitmap_bounds(GContext *ctx) { run_mask_bitmap_changed(ctx, false); }
+
+// the mask is resolved into cached coverage, so what it lets the background through is the text alone: black stripes
+// and text of the fixture under it are in the mask color already and stay (drawing the mask every frame replaced them)
+static void run_mask_keeps_screen_mask_colors(GContext *ctx) {
+  run_mask(ctx, GRect(0, 56, W, 50), NULL);
+}
+
+static void run_fps(GContext *ctx) {
+  EffectFPS fps = {0};
+  GRect rect = GRect(4, H - 24, 100, 20);
+  host_context_set_origin(ctx, rect.origin);
+  host_set_time_ms(1000000);
+  effect_fps(ctx, rect, &fps);
+  host_set_time_ms(1000000 + 2500);
+  for (int i = 0; i < 3; i++) effect_fps(ctx, rect, &fps);
+}
+
+static void run_long_shadow(GContext *ctx, EffectOffset *shadow) {
+  effect_shadow(ctx, GRect(0, 80, W, 50), shadow);
+}
+
+static void run_long_shadow_down(GContext *ctx) { run_long_shadow(ctx, &s_long_shadow); }
+static void run_long_shadow_up(GContext *ctx) { run_long_shadow(ctx, &s_long_shadow_up); }
+
+// set_line from the middle of the screen out over all four edges and across the screen from outside, over the
+// fixture's black pixels (skipped); with visited Aplite lines pass over pixels earlier lines drew
+static void run_lines(GContext *ctx, bool use_visited) {
+  static uint8_t visited[PBL_IF_COLOR_ELSE(1, 20) * H];
+  memset(visited, 0, sizeof(visited));
+  GBitmap *fb = graphics_capture_frame_buffer(ctx);
+  BitmapInfo bitmap_info = { fb, gbitmap_get_data(fb), gbitmap_get_bytes_per_row(fb), gbitmap_get_format(fb) };
+  uint8_t draw = PBL_IF_COLOR_ELSE(GColorRedARGB8, 1), skip = PBL_IF_COLOR_ELSE(GColorBlackARGB8, 0);
+  
+  // points on a frame 30 pixels outside the screen, walked around it
+  GPoint frame[24];
+  for (int i = 0; i < 6; i++) {
+    frame[i] = GPoint(-30 + i * (W + 60) / 6, -30);
+    frame[6 + i] = GPoint(W + 30, -30 + i * (H + 60) / 6);
+    frame[12 + i] = GPoint(W + 30 - i * (W + 60) / 6, H + 30);
+    frame[18 + i] = GPoint(-30, H + 30 - i * (H + 60) / 6);
+  }
+  for (int i = 0; i < 24; i++) {
+    set_line(bitmap_info, H / 2 + i % 5, W / 2 - i % 3, frame[i].y, frame[i].x, draw, skip, use_visited ? visited : NULL);
+  }
+  for (int i = 0; i < 12; i += 2) {
+    set_line(bitmap_info, frame[i].y + 3, frame[i].x, frame[i + 11].y, frame[i + 11].x, draw, skip, use_visited ? visited : NULL);
+  }
+  // short ones: a dot, lines along the edges
+  set_line(bitmap_info, 7, 7, 7, 7, draw, skip, use_visited ? visited : NULL);
+  set_line(bitmap_info, 0, -5, 0, W + 5, draw, skip, use_visited ? visited : NULL);
+  set_line(bitmap_info, H + 5, W - 1, -5, W - 1, draw, skip, use_visited ? visited : NULL);
+  graphics_release_frame_buffer(ctx, fb);
+}
+
+static void run_lines_plain(GContext *ctx) { run_lines(ctx, false); }
+static void run_lines_visited(GContext *ctx) { run_lines(ctx, true); }
+
+// effects running through effect layers: color mapping effects fused into one pass, a layer partly off screen
+static void run_layers(GContext *ctx) {
+  Layer *root = layer_create(GRect(0, 0, W, H));
+  EffectLayer *fused = effect_layer_create(GRect(10, 20, 90, 70));
+  effect_layer_add_effect(fused, effect_invert_bw_only, NULL);
+  effect_layer_add_effect(fused, effect_colorswap, &s_black_white);
+  effect_layer_add_effect(fused, effect_invert, NULL);
+  EffectLayer *edge = effect_layer_create(GRect(W - 40, H - 50, 80, 80));
+  effect_layer_add_effect(edge, effect_mirror_horizontal, NULL);
+  effect_layer_add_effect(edge, effect_invert, NULL);
+  layer_add_child(root, effect_layer_get_layer(fused));
+  layer_add_child(root, effect_layer_get_layer(edge));
+
+  host_render(root, ctx);
+
+  effect_layer_destroy(fused);
+  effect_layer_destroy(edge);
+  layer_destroy(root);
+}
+
+// aborts the run when the framebuffer was captured other than "expected" times since "before"
+static void expect_captures(GContext *ctx, int before, int expected, const char *what) {
+  if (host_context_captures(ctx) - before != expected) {
+    fprintf(stderr, "%s: %d framebuffer captures, expected %d\n", what, host_context_captures(ctx) - before, expected);
+    abort();
+  }
+}
+
+// two effect layers registered with a compositor above them: both run when the compositor is drawn, under one capture
+static void run_compositor(GContext *ctx) {
+  Layer *root = layer_create(GRect(0, 0, W, H));
+  EffectLayer *first = effect_layer_create(GRect(10, 20, 90, 70));
+  effect_layer_add_effect(first, effect_invert, NULL);
+  EffectLayer *second = effect_layer_create(GRect(40, 60, W - 30, 80));
+  effect_layer_add_effect(second, effect_colorswap, &s_black_white);
+  effect_layer_add_effect(second, effect_mirror_vertical, NULL);
+  EffectCompositor *compositor = effect_compositor_create(GRect(0, 0, W, H));
+  effect_layer_set_compositor(first, compositor);
+  effect_layer_set_compositor(second, compositor);
+  layer_add_child(root, effect_layer_get_layer(first));
+  layer_add_child(root, effect_layer_get_layer(second));
+  layer_add_child(root, effect_compositor_get_layer(compositor));
+
+  int before = host_context_captures(ctx);
+  host_render(root, ctx);
+  expect_captures(ctx, before, 1, "compositor");
+
+  effect_layer_destroy(first);
+  effect_layer_destroy(second);
+  effect_compositor_destroy(compositor);
+  layer_destroy(root);
+}
+
+// layers leaving the compositor between being drawn and the compositor being drawn: destroyed and unregistered ones
+// are dropped from the frame, the remaining one runs; after the compositor is gone that one runs on its own
+static void run_compositor_pending(GContext *ctx) {
+  Layer *root = layer_create(GRect(0, 0, W, H));
+  EffectLayer *destroyed = effect_layer_create(GRect(0, 0, W, 40));
+  effect_layer_add_effect(destroyed, effect_invert, NULL);
+  EffectLayer *detached = effect_layer_create(GRect(0, 50, W, 40));
+  effect_layer_add_effect(detached, effect_invert, NULL);
+  EffectLayer *kept = effect_layer_create(GRect(20, 100, 60, 40));
+  effect_layer_add_effect(kept, effect_invert, NULL);
+  EffectCompositor *compositor = effect_compositor_create(GRect(0, 0, W, H));
+  effect_layer_set_compositor(destroyed, compositor);
+  effect_layer_set_compositor(detached, compositor);
+  effect_layer_set_compositor(kept, compositor);
+  layer_add_child(root, effect_layer_get_layer(destroyed));
+  layer_add_child(root, effect_layer_get_layer(detached));
+  layer_add_child(root, effect_layer_get_layer(kept));
+
+  int before = host_context_captures(ctx);
+  host_render(root, ctx); // all three wait for the compositor
+  expect_captures(ctx, before, 0, "compositor_pending: layers");
+  effect_layer_destroy(destroyed);
+  effect_layer_set_compositor(detached, NULL);
+  host_render(effect_compositor_get_layer(compositor), ctx);
+  expect_captures(ctx, before, 1, "compositor_pending: compositor");
+
+  effect_compositor_destroy(compositor);
+  effect_layer_set_frame(kept, GRect(W - 70, 100, 60, 40));
+  host_render(effect_layer_get_layer(kept), ctx);
+  expect_captures(ctx, before, 2, "compositor_pending: layer on its own");
+
+  effect_layer_destroy(detached);
+  effect_layer_destroy(kept);
+  layer_destroy(root);
+}
+
+// aborts the run when the screen origin cached by the layer is not where the layer is now
+static void expect_origin(EffectLayer *effect_layer, const char *what) {
+  GPoint screen = layer_convert_point_to_screen(effect_layer_get_layer(effect_layer), GPointZero);
+  if (!effect_layer->origin_valid || !gpoint_equal(&effect_layer->screen_origin, &screen)) {
+    fprintf(stderr, "%s: cached origin %d,%d, layer at %d,%d\n", what, effect_layer->screen_origin.x,
+            effect_layer->screen_origin.y, screen.x, screen.y);
+    abort();
+  }
+}
+
+// effect layer in a parent moved after the first frame: by the parent (with effect_layer_invalidate_origin), then by
+// effect_layer_set_frame - each frame runs at the new screen rect, only the last one is left in the image
+static void run_layer_moved(GContext *ctx) {
+  Layer *root = layer_create(GRect(0, 0, W, H));
+  Layer *parent = layer_create(GRect(10, 10, W - 20, H - 20));
+  EffectLayer *moved = effect_layer_create(GRect(5, 5, 60, 40));
+  effect_layer_add_effect(moved, effect_colorswap, &s_black_white);
+  layer_add_child(root, parent);
+  layer_add_child(parent, effect_layer_get_layer(moved));
+
+  host_render(root, ctx);
+  expect_origin(moved, "layer_moved: first frame");
+  draw_fixture(ctx);
+  layer_set_frame(parent, GRect(30, 50, W - 40, H - 60));
+  effect_layer_invalidate_origin(moved);
+  host_render(root, ctx);
+  expect_origin(moved, "layer_moved: parent moved");
+  draw_fixture(ctx);
+  effect_layer_set_frame(moved, GRect(20, 40, 60, 40));
+  host_render(root, ctx);
+  expect_origin(moved, "layer_moved: frame set");
+
+  effect_layer_destroy(moved);
+  layer_destroy(parent);
+  layer_destroy(root);
+}
+
+// effect layers keep tables per effect: two lenses and a zoom, the second frame runs from the cached tables
+static void run_layer_caches(GContext *ctx) {
+  Layer *root = layer_create(GRect(0, 0, W, H));
+  EffectLayer *first = effect_layer_create(GRect(10, 20, 60, 60));
+  effect_layer_add_effect(first, effect_lens, EL_LENS(80, 30));
+  EffectLayer *second = effect_layer_create(GRect(W - 80, H - 90, 70, 70));
+  effect_layer_add_effect(second, effect_zoom, EL_ZOOM(150, 150));
+  effect_layer_add_effect(second, effect_lens, EL_LENS(120, 20));
+  layer_add_child(root, effect_layer_get_layer(first));
+  layer_add_child(root, effect_layer_get_layer(second));
+
+  host_render(root, ctx);
+  draw_fixture(ctx);
+  host_render(root, ctx);
+
+  effect_layer_remove_effect(second);
+  effect_layer_destroy(first);
+  effect_layer_destroy(second);
+  layer_destroy(root);
+}
+
+static const TestCase s_cases[] = {
+  { "invert_full", effect_invert, NULL, {{0, 0}, {W, H}} },
+  { "invert_rect", effect_invert, NULL, {{3, 5}, {61, 40}} },
+  { "invert_offscreen", effect_invert, NULL, {{-20, -10}, {70, 60}} },
+  { "invert_offscreen_far", effect_invert, NULL, {{W - 30, H - 20}, {60, 60}} },
+  { "invert_bw_only", effect_invert_bw_only, NULL, {{0, 0}, {W, H}} },
+  { "invert_brightness", effect_invert_brightness, NULL, {{0, 0}, {W, H}} },
+  { "palette_map", effect_palette_map, s_channel_rotation, {{5, 10}, {W - 10, 100}} },
+  { "colorize", effect_colorize, &s_black_to_red, {{0, 50}, {W, 60}} },
+  { "colorswap", effect_colorswap, &s_black_white, {{0, 50}, {W, 60}} },
+  { "mirror_vertical", effect_mirror_vertical, NULL, {{10, 20}, {100, 81}} },
+  { "mirror_horizontal", effect_mirror_horizontal, NULL, {{10, 20}, {101, 80}} },
+  { "rotate_right", effect_rotate_90_degrees, (void *)true, {{20, 30}, {80, 80}} },
+  { "rotate_left", effect_rotate_90_degrees, (void *)false, {{20, 30}, {80, 80}} },
+  { "rotate_offscreen", effect_rotate_90_degrees, (void *)true, {{-30, 110}, {80, 80}} },
+  { "blur_1", effect_blur, (void *)1, {{10, 10}, {100, 100}} },
+  { "blur_4", effect_blur, (void *)4, {{0, 0}, {W, H}} },
+  { "zoom_in", effect_zoom, EL_ZOOM(150, 200), {{10, 20}, {120, 100}} },
+  { "zoom_out", effect_zoom, EL_ZOOM(60, 50), {{10, 20}, {120, 100}} },
+  { "affine", effect_affine, &s_affine, {{10, 30}, {110, 100}} },
+  { "lens", effect_lens, EL_LENS(80, 30), {{30, 40}, {80, 80}} },
+  { "lens_edge", effect_lens, EL_LENS(120, 60), {{-20, H - 60}, {90, 90}} },
+  { "mask_text", NULL, NULL, {{0, 0}, {0, 0}}, run_mask_text },
+  { "mask_bitmap", NULL, NULL, {{0, 0}, {0, 0}}, run_mask_bitmap },
+  { "mask_recolored", NULL, NULL, {{0, 0}, {0, 0}}, run_mask_recolored },
+  { "mask_bitmap_invalidated", NULL, NULL, {{0, 0}, {0, 0}}, run_mask_bitmap_invalidated },
+  { "mask_bitmap_bounds", NULL, NULL, {{0, 0}, {0, 0}}, run_mask_bitmap_bounds },
+  { "mask_keeps_screen_mask_colors", NULL, NULL, {{0, 0}, {0, 0}}, run_mask_keeps_screen_mask_colors },
+  { "fps", NULL, NULL, {{0, 0}, {0, 0}}, run_fps },
+  { "shadow", effect_shadow, &s_shadow, {{0, 80}, {W, 50}} },
+  { "shadow_same_color", effect_shadow, &s_shadow_same, {{0, 80}, {W, 50}} },
+  { "long_shadow", NULL, NULL, {{0, 0}, {0, 0}}, run_long_shadow_down },
+  { "long_shadow_up", NULL, NULL, {{0, 0}, {0, 0}}, run_long_shadow_up },
+  { "lines", NULL, NULL, {{0, 0}, {0, 0}}, run_lines_plain },
+  { "lines_visited", NULL, NULL, {{0, 0}, {0, 0}}, run_lines_visited },
+  { "outline", effect_outline, &s_outline, {{0, 80}, {W, 50}} },
+  { "layers", NULL, NULL, {{0, 0}, {0, 0}}, run_layers },
+  { "layer_moved", NULL, NULL, {{0, 0}, {0, 0}}, run_layer_moved },
+  { "layer_caches", NULL, NULL, {{0, 0}, {0, 0}}, run_layer_caches },
+  { "compositor", NULL, NULL, {{0, 0}, {0, 0}}, run_compositor },
+  { "compositor_pending", NULL, NULL, {{0, 0}, {0, 0}}, run_compositor_pending },
+};
+
+//  ********* runner *********
+
+static uint8_t *run_case(const TestCase *test, GBitmap *fb, GContext *ctx) {
+  draw_fixture(ctx);
+  if (test->run) {
+    test->run(ctx);
+  } else {
+    host_context_set_origin(ctx, test->rect.origin);
+    test->effect(ctx, test->rect, test->param);
+  }
+  size_t size = host_framebuffer_size(fb);
+  uint8_t *copy = malloc(size);
+  memcpy(copy, gbitmap_get_data(fb), size);
+  return copy;
+}
+
+static uint8_t *read_file(const char *path, size_t *size) {
+  FILE *file = fopen(path, "rb");
+  if (!file) return NULL;
+  fseek(file, 0, SEEK_END);
+  *size = ftell(file);
+  fseek(file, 0, SEEK_SET);
+  uint8_t *data = malloc(*size ? *size : 1);
+  if (fread(data, 1, *size, file) != *size) {
+    free(data);
+    data = NULL;
+  }
+  fclose(file);
+  return data;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    fprintf(stderr, "usage: %s <golden dir> [--update] [case...]\n", argv[0]);
+    return 2;
+  }
+  bool update = argc > 2 && strcmp(argv[2], "--update") == 0;
+  int first_name = update ? 3 : 2;
+
+  for (int c = 0; c < 256; c++) s_channel_rotation[c] = (c & 0xC0) | ((c & 0x03) << 4) | ((c & 0x3C) >> 2);
+  effect_affine_rotate_scale(&s_affine, TRIG_MAX_ANGLE / 12, 0x14000);
+  s_affine.background_color = GColorBlue;
+
+  GBitmap *fb = host_framebuffer_create();
+  GContext *ctx = host_context_create(fb);
+  size_t size = host_framebuffer_size(fb);
+  int failed = 0, ran = 0;
+
+  for (size_t i = 0; i < sizeof(s_cases) / sizeof(s_cases[0]); i++) {
+    const TestCase *test = &s_cases[i];
+    bool selected = first_name >= argc;
+    for (int a = first_name; a < argc; a++) selected |= strcmp(argv[a], test->name) == 0;
+    if (!selected) continue;
+    ran++;
+    char path[512];
+    snprintf(path, sizeof(path), "%s/%s/%s.fb", argv[1], PLATFORM_NAME, test->name);
+
+    uint8_t *first = run_case(test, fb, ctx);
+    uint8_t *second = run_case(test, fb, ctx);
+    if (memcmp(first, second, size) != 0) {
+      printf("FAIL %s/%s: second run differs from the first\n", PLATFORM_NAME, test->name);
+      failed++;
+    } else if (update) {
+      FILE *file = fopen(path, "wb");
+      if (!file || fwrite(first, 1, size, file) != size) {
+        printf("FAIL %s: cannot write\n", path);
+        failed++;
+      }
+      if (file) fclose(file);
+    } else {
+      size_t golden_size = 0;
+      uint8_t *golden = read_file(path, &golden_size);
+      if (!golden || golden_size != size) {
+        printf("FAIL %s/%s: missing golden image %s\n", PLATFORM_NAME, test->name, path);
+        failed++;
+      } else if (memcmp(golden, first, size) != 0) {
+        size_t differ = 0, at = 0;
+        for (size_t b = size; b-- > 0; ) if (golden[b] != first[b]) { differ++; at = b; }
+        printf("FAIL %s/%s: %zu bytes differ from golden image, first at byte %zu\n", PLATFORM_NAME, test->name, differ, at);
+        failed++;
+      }
+      free(golden);
+    }
+    free(first);
+    free(second);
+  }
+
+  printf("%s: %d of %d cases failed\n", PLATFORM_NAME, failed, ran);
+  host_context_destroy(ctx);
+  gbitmap_destroy(fb);
+  return failed ? 1 : 0;
+}
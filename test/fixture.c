@@ -0,0 +1,44 @@
+// Scene shared by the golden-image tests and the benchmark
+#include <pebble.h>
+#include "fixture.h"
+
+// fixture: white background, band of colors, stripes, a block and text - on 1bit screen colors other than white
+// come out black, so there the band turns into a pattern
+void draw_fixture(GContext *ctx) {
+  host_context_set_origin(ctx, GPointZero);
+  graphics_context_set_fill_color(ctx, GColorWhite);
+  graphics_fill_rect(ctx, GRect(0, 0, W, H), 0, GCornerNone);
+
+  for (int x = 0; x < W; x += 3) {
+    graphics_context_set_fill_color(ctx, GColorARGB8(0xC0 | ((x * 5 / 3) & 0x3F)));
+    graphics_fill_rect(ctx, GRect(x, 24, 3, 30), 0, GCornerNone);
+  }
+  graphics_context_set_fill_color(ctx, GColorBlack);
+  for (int y = 60; y < 80; y += 4) graphics_fill_rect(ctx, GRect(0, y, W, 2), 0, GCornerNone);
+  graphics_context_set_fill_color(ctx, GColorRed);
+  graphics_fill_rect(ctx, GRect(W / 2 - 25, H - 60, 50, 30), 0, GCornerNone);
+  graphics_context_set_fill_color(ctx, GColorBlack);
+  graphics_fill_rect(ctx, GRect(W / 2 - 15, H - 52, 30, 14), 0, GCornerNone);
+
+  graphics_context_set_text_color(ctx, GColorBlack);
+  graphics_draw_text(ctx, "12:34 WED", NULL, GRect(10, 88, W - 20, 40), GTextOverflowModeWordWrap, GTextAlignmentCenter, NULL);
+  graphics_context_set_text_color(ctx, GColorBlue);
+  graphics_draw_text(ctx, "QROW", NULL, GRect(20, 6, W - 40, 12), GTextOverflowModeWordWrap, GTextAlignmentLeft, NULL);
+}
+
+// bitmap of the framebuffer format with diagonal stripes in two colors
+GBitmap *create_pattern_bitmap(GSize size, GColor a, GColor b) {
+  GBitmap *bitmap = gbitmap_create_blank(size, PBL_IF_COLOR_ELSE(GBitmapFormat8Bit, GBitmapFormat1Bit));
+  uint8_t *data = gbitmap_get_data(bitmap);
+  int bytes_per_row = gbitmap_get_bytes_per_row(bitmap);
+  for (int y = 0; y < size.h; y++)
+    for (int x = 0; x < size.w; x++) {
+      GColor color = ((x + y) / 4) % 2 ? a : b;
+#ifdef PBL_COLOR
+      data[y * bytes_per_row + x] = color.argb;
+#else
+      if (gcolor_equal(color, GColorWhite)) data[y * bytes_per_row + x / 8] |= 1 << (x % 8);
+#endif
+    }
+  return bitmap;
+}
@@ -0,0 +1,16 @@
+#pragma once
+#include <pebble.h>
+
+#if defined(PBL_PLATFORM_APLITE)
+  #define PLATFORM_NAME "aplite"
+#elif defined(PBL_PLATFORM_CHALK)
+  #define PLATFORM_NAME "chalk"
+#else
+  #define PLATFORM_NAME "basalt"
+#endif
+
+#define W PBL_DISPLAY_WIDTH
+#define H PBL_DISPLAY_HEIGHT
+
+void draw_fixture(GContext *ctx); // whole screen, with the context origin reset to the screen's
+GBitmap *create_pattern_bitmap(GSize size, GColor a, GColor b); // framebuffer format, diagonal stripes of a and b
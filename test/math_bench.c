@@ -0,0 +1,291 @@
+// Fixed point math (fx_*) against libm and the float versions (my_*) it replaced: largest error over the whole input
+// range and host time per call, as CSV. Errors are in the unit of the fixed point result: 1 for fx_sqrt (floor of
+// the root), angle units (TRIG_MAX_ANGLE per turn) for fx_asin/acos/atan, and for fx_tan the error of the ratio,
+// relative beyond 45 degrees. Float versions are measured in the same unit.
+#include <math.h>
+#include <pebble.h>
+#include "math.h"
+
+//  ********* float versions, as the library had them *********
+// Taken from Michael Ehrmann source code of SunClock https://github.com/mehrmann/pebble-sunclock
+
+/* 
+ * loosely based on 
+ * - http://stackoverflow.com/questions/11261170/c-and-maths-fast-approximation-of-a-trigonometric-function
+ * - http://www.codeproject.com/Articles/69941/Best-Square-Root-Method-Algorithm-Function-Precisi
+ */
+
+#define SQRT_MAGIC_F 0x5f3759df 
+static float my_sqrt(const float x)
+{
+  const float xhalf = 0.5f*x;
+ 
+  union // get bits for floating value
+  {
+    float x;
+    int i;
+  } u;
+  u.x = x;
+  u.i = SQRT_MAGIC_F - (u.i >> 1);  // gives initial guess y0
+  return x*u.x*(1.5f - xhalf*u.x*u.x);// Newton step, repeating increases accuracy 
+}   
+
+static float my_floor(float x) 
+{
+  return ((int)x);
+}
+
+static float my_fabs(float x)
+{
+  if (x<0) return -x;
+  return x;
+}
+
+static float my_atan(float x)
+{
+  if (x>=0) // 0 must not recurse: -0 is not below 0 either 
+  {
+    return (M_PI/2)*(0.596227*x + x*x)/(1 + 2*0.596227*x + x*x);
+  } 
+  else
+  {
+    return -(my_atan(-x));
+  }
+}
+
+/* not quite rint(), i.e. results not properly rounded to nearest-or-even */
+static float my_rint (float x)
+{
+  float t = my_floor (my_fabs(x) + 0.5);
+  return (x < 0.0) ? -t : t;
+}
+
+/* minimax approximation to cos on [-pi/4, pi/4] with rel. err. ~= 7.5e-13 */
+static float cos_core (float x)
+{
+  float x8, x4, x2;
+  x2 = x * x;
+  x4 = x2 * x2;
+  x8 = x4 * x4;
+  /* evaluate polynomial using Estrin's scheme */
+  return (-2.7236370439787708e-7 * x2 + 2.4799852696610628e-5) * x8 +
+         (-1.3888885054799695e-3 * x2 + 4.1666666636943683e-2) * x4 +
+         (-4.9999999999963024e-1 * x2 + 1.0000000000000000e+0);
+}
+
+/* minimax approximation to sin on [-pi/4, pi/4] with rel. err. ~= 5.5e-12 */
+static float sin_core (float x)
+{
+  float x4, x2;
+  x2 = x * x;
+  x4 = x2 * x2;
+  /* evaluate polynomial using a mix of Estrin's and Horner's scheme */
+  return ((2.7181216275479732e-6 * x2 - 1.9839312269456257e-4) * x4 + 
+          (8.3333293048425631e-3 * x2 - 1.6666666640797048e-1)) * x2 * x + x;
+}
+
+/* minimax approximation to arcsin on [0, 0.5625] with rel. err. ~= 1.5e-11 */
+static float asin_core (float x)
+{
+  float x8, x4, x2;
+  x2 = x * x;
+  x4 = x2 * x2;
+  x8 = x4 * x4;
+  /* evaluate polynomial using a mix of Estrin's and Horner's scheme */
+  return (((4.5334220547132049e-2 * x2 - 1.1226216762576600e-2) * x4 +
+           (2.6334281471361822e-2 * x2 + 2.0596336163223834e-2)) * x8 +
+          (3.0582043602875735e-2 * x2 + 4.4630538556294605e-2) * x4 +
+          (7.5000364034134126e-2 * x2 + 1.6666666300567365e-1)) * x2 * x + x; 
+}
+
+/* relative error < 7e-12 on [-50000, 50000] */
+static float my_sin (float x)
+{
+  float q, t;
+  int quadrant;
+  /* Cody-Waite style argument reduction */
+  q = my_rint (x * 6.3661977236758138e-1);
+  quadrant = (int)q;
+  t = x - q * 1.5707963267923333e+00;
+  t = t - q * 2.5633441515945189e-12;
+  if (quadrant & 1) {
+    t = cos_core(t);
+  } else {
+    t = sin_core(t);
+  }
+  return (quadrant & 2) ? -t : t;
+}
+
+static float my_cos(float x)
+{
+  return my_sin(x + (M_PI/2));
+}
+
+/* relative error < 2e-11 on [-1, 1] */
+static float my_acos (float x)
+{
+  float xa, t;
+  xa = my_fabs (x);
+  /* arcsin(x) = pi/2 - 2 * arcsin (sqrt ((1-x) / 2)) 
+   * arccos(x) = pi/2 - arcsin(x)
+   * arccos(x) = 2 * arcsin (sqrt ((1-x) / 2))
+   */
+  if (xa > 0.5625) {
+    t = 2.0 * asin_core (my_sqrt (0.5 * (1.0 - xa)));
+  } else {
+    t = 1.5707963267948966 - asin_core (xa);
+  }
+  /* arccos (-x) = pi - arccos(x) */
+  return (x < 0.0) ? (3.1415926535897932 - t) : t;
+}
+
+static float my_asin (float x)
+{
+  return (M_PI/2) - my_acos(x);
+}
+
+static float my_tan(float x)
+{
+  return my_sin(x) / my_cos(x);
+}
+
+//  ********* bench *********
+
+
+#define ANGLE_PER_RADIAN (TRIG_MAX_ANGLE / (2 * 3.14159265358979323846))
+#define REPEAT 20
+
+static volatile double s_sink; // keeps timed results alive
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// ns per call of expr over all inputs[i], best of REPEAT runs
+#define TIME_CALLS(result, inputs, count, expr) do { \
+    result = 1e30; \
+    for (int run = 0; run < REPEAT; run++) { \
+      double sum = 0; \
+      uint64_t start = now_ns(); \
+      for (int i = 0; i < (count); i++) { int32_t x = (inputs)[i]; sum += (expr); } \
+      double ns = (double)(now_ns() - start) / (count); \
+      s_sink += sum; \
+      if (ns < result) result = ns; \
+    } \
+  } while (0)
+
+static void print_row(const char *name, int count, double error_fx, double error_float, const char *unit,
+                      double ns_fx, double ns_float, double ns_libm) {
+  printf("%s,%d,%.4g,%.4g,%s,%.2f,%.2f,%.2f\n", name, count, error_fx, error_float, unit, ns_fx, ns_float, ns_libm);
+}
+
+static double max_double(double a, double b) { return a > b ? a : b; }
+
+static void bench_sqrt(void) {
+  // every value below 2^20, then larger ones spread over the rest of the range
+  int count = (1 << 20) + (1 << 18);
+  uint32_t *inputs = malloc(count * sizeof(uint32_t));
+  uint32_t seed = 1;
+  for (int i = 0; i < count; i++) {
+    seed = seed * 1664525 + 1013904223;
+    inputs[i] = i < (1 << 20) ? (uint32_t)i : seed;
+  }
+  double error_fx = 0, error_float = 0;
+  for (int i = 0; i < count; i++) {
+    double root = sqrt((double)inputs[i]);
+    error_fx = max_double(error_fx, fabs(fx_sqrt(inputs[i]) - floor(root)));
+    error_float = max_double(error_float, fabs(my_sqrt((float)inputs[i]) - root));
+  }
+  double ns_fx, ns_float, ns_libm;
+  TIME_CALLS(ns_fx, inputs, count, fx_sqrt((uint32_t)x));
+  TIME_CALLS(ns_float, inputs, count, my_sqrt((float)(uint32_t)x));
+  TIME_CALLS(ns_libm, inputs, count, sqrt((double)(uint32_t)x));
+  print_row("sqrt", count, error_fx, error_float, "1", ns_fx, ns_float, ns_libm);
+  free(inputs);
+}
+
+// asin and acos over every Q16 value in [-1, 1]
+static void bench_asin_acos(bool acos_of) {
+  int count = 2 * FX_ONE + 1;
+  int32_t *inputs = malloc(count * sizeof(int32_t));
+  for (int i = 0; i < count; i++) inputs[i] = i - FX_ONE;
+  double error_fx = 0, error_float = 0;
+  for (int i = 0; i < count; i++) {
+    double ratio = (double)inputs[i] / FX_ONE;
+    double angle = (acos_of ? acos(ratio) : asin(ratio)) * ANGLE_PER_RADIAN;
+    int32_t fx = acos_of ? fx_acos(inputs[i]) : fx_asin(inputs[i]);
+    float value = acos_of ? my_acos((float)ratio) : my_asin((float)ratio);
+    error_fx = max_double(error_fx, fabs(fx - angle));
+    error_float = max_double(error_float, fabs(value * ANGLE_PER_RADIAN - angle));
+  }
+  double ns_fx, ns_float, ns_libm;
+  if (acos_of) {
+    TIME_CALLS(ns_fx, inputs, count, fx_acos(x));
+    TIME_CALLS(ns_float, inputs, count, my_acos((float)x / FX_ONE));
+    TIME_CALLS(ns_libm, inputs, count, acos((double)x / FX_ONE));
+  } else {
+    TIME_CALLS(ns_fx, inputs, count, fx_asin(x));
+    TIME_CALLS(ns_float, inputs, count, my_asin((float)x / FX_ONE));
+    TIME_CALLS(ns_libm, inputs, count, asin((double)x / FX_ONE));
+  }
+  print_row(acos_of ? "acos" : "asin", count, error_fx, error_float, "angle", ns_fx, ns_float, ns_libm);
+  free(inputs);
+}
+
+// atan over [-64, 64] in steps of 1/16384 and a spread of larger values
+static void bench_atan(void) {
+  int small = 2 * 64 * 4 * FX_ONE / 16 + 1;
+  int count = small + 4096;
+  int32_t *inputs = malloc(count * sizeof(int32_t));
+  uint32_t seed = 1;
+  for (int i = 0; i < count; i++) {
+    seed = seed * 1664525 + 1013904223;
+    inputs[i] = i < small ? (i - small / 2) * 4 : (int32_t)seed;
+  }
+  double error_fx = 0, error_float = 0;
+  for (int i = 0; i < count; i++) {
+    double ratio = (double)inputs[i] / FX_ONE;
+    double angle = atan(ratio) * ANGLE_PER_RADIAN;
+    error_fx = max_double(error_fx, fabs(fx_atan(inputs[i]) - angle));
+    error_float = max_double(error_float, fabs(my_atan((float)ratio) * ANGLE_PER_RADIAN - angle));
+  }
+  double ns_fx, ns_float, ns_libm;
+  TIME_CALLS(ns_fx, inputs, count, fx_atan(x));
+  TIME_CALLS(ns_float, inputs, count, my_atan((float)x / FX_ONE));
+  TIME_CALLS(ns_libm, inputs, count, atan((double)x / FX_ONE));
+  print_row("atan", count, error_fx, error_float, "angle", ns_fx, ns_float, ns_libm);
+  free(inputs);
+}
+
+// tan over every angle strictly between -90 and 90 degrees
+static void bench_tan(void) {
+  int count = TRIG_MAX_ANGLE / 2 - 1;
+  int32_t *inputs = malloc(count * sizeof(int32_t));
+  for (int i = 0; i < count; i++) inputs[i] = i - (TRIG_MAX_ANGLE / 4 - 1);
+  double error_fx = 0, error_float = 0;
+  for (int i = 0; i < count; i++) {
+    double radians = inputs[i] / ANGLE_PER_RADIAN;
+    double ratio = tan(radians);
+    double scale = fabs(ratio) > 1 ? fabs(ratio) : 1;
+    error_fx = max_double(error_fx, fabs((double)fx_tan(inputs[i]) / FX_ONE - ratio) / scale);
+    error_float = max_double(error_float, fabs(my_tan((float)radians) - ratio) / scale);
+  }
+  double ns_fx, ns_float, ns_libm;
+  TIME_CALLS(ns_fx, inputs, count, fx_tan(x));
+  TIME_CALLS(ns_float, inputs, count, my_tan((float)(x / ANGLE_PER_RADIAN)));
+  TIME_CALLS(ns_libm, inputs, count, tan(x / ANGLE_PER_RADIAN));
+  print_row("tan", count, error_fx, error_float, "ratio", ns_fx, ns_float, ns_libm);
+  free(inputs);
+}
+
+int main(void) {
+  printf("function,inputs,max_error_fx,max_error_float,unit,ns_per_call_fx,ns_per_call_float,ns_per_call_libm\n");
+  bench_sqrt();
+  bench_asin_acos(false);
+  bench_asin_acos(true);
+  bench_atan();
+  bench_tan();
+  return 0;
+}
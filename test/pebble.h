@@ -0,0 +1,270 @@
+// Host stand-in for the parts of the Pebble SDK the effect library uses, so effects.c, blur.c, math.c and
+// effect_layer.c build and run on Linux. Platform is picked the same way the SDK does it: build with
+// -DPBL_PLATFORM_APLITE -DPBL_BW -DPBL_RECT, -DPBL_PLATFORM_BASALT -DPBL_COLOR -DPBL_RECT or
+// -DPBL_PLATFORM_CHALK -DPBL_COLOR -DPBL_ROUND. Implementation is in pebble_host.c.
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(PBL_PLATFORM_CHALK)
+  #define PBL_DISPLAY_WIDTH 180
+  #define PBL_DISPLAY_HEIGHT 180
+#else
+  #define PBL_DISPLAY_WIDTH 144
+  #define PBL_DISPLAY_HEIGHT 168
+#endif
+
+#ifdef PBL_ROUND
+  #define PBL_IF_ROUND_ELSE(if_true, if_false) (if_true)
+#else
+  #define PBL_IF_ROUND_ELSE(if_true, if_false) (if_false)
+#endif
+#ifdef PBL_COLOR
+  #define PBL_IF_COLOR_ELSE(if_true, if_false) (if_true)
+#else
+  #define PBL_IF_COLOR_ELSE(if_true, if_false) (if_false)
+#endif
+
+#define APP_LOG_LEVEL_ERROR 1
+#define APP_LOG_LEVEL_WARNING 50
+#define APP_LOG_LEVEL_INFO 100
+#define APP_LOG_LEVEL_DEBUG 200
+#define APP_LOG(level, ...) host_log(level, __VA_ARGS__)
+void host_log(int level, const char *fmt, ...);
+
+// geometry
+typedef struct { int16_t x, y; } GPoint;
+typedef struct { int16_t w, h; } GSize;
+typedef struct { GPoint origin; GSize size; } GRect;
+#define GPoint(x, y) ((GPoint){(x), (y)})
+#define GPointZero GPoint(0, 0)
+#define GSize(w, h) ((GSize){(w), (h)})
+#define GRect(x, y, w, h) ((GRect){{(x), (y)}, {(w), (h)}})
+#define GRectZero GRect(0, 0, 0, 0)
+bool gpoint_equal(const GPoint *a, const GPoint *b);
+bool grect_equal(const GRect *a, const GRect *b);
+
+// colors: 8bit argb on every platform, as in SDK 3+
+typedef union GColor8 {
+  uint8_t argb;
+  struct { uint8_t b:2; uint8_t g:2; uint8_t r:2; uint8_t a:2; };
+} GColor8;
+typedef GColor8 GColor;
+#define GColorARGB8(v) ((GColor8){.argb = (v)})
+#define GColorFromRGB(red, green, blue) \
+  ((GColor8){.a = 3, .r = (uint8_t)(red) >> 6, .g = (uint8_t)(green) >> 6, .b = (uint8_t)(blue) >> 6})
+#define GColorClearARGB8 ((uint8_t)0x00)
+#define GColorClear GColorARGB8(GColorClearARGB8)
+#define GColorBlackARGB8 ((uint8_t)0xC0)
+#define GColorBlack GColorARGB8(GColorBlackARGB8)
+#define GColorOxfordBlueARGB8 ((uint8_t)0xC1)
+#define GColorOxfordBlue GColorARGB8(GColorOxfordBlueARGB8)
+#define GColorDukeBlueARGB8 ((uint8_t)0xC2)
+#define GColorDukeBlue GColorARGB8(GColorDukeBlueARGB8)
+#define GColorBlueARGB8 ((uint8_t)0xC3)
+#define GColorBlue GColorARGB8(GColorBlueARGB8)
+#define GColorDarkGreenARGB8 ((uint8_t)0xC4)
+#define GColorDarkGreen GColorARGB8(GColorDarkGreenARGB8)
+#define GColorMidnightGreenARGB8 ((uint8_t)0xC5)
+#define GColorMidnightGreen GColorARGB8(GColorMidnightGreenARGB8)
+#define GColorCobaltBlueARGB8 ((uint8_t)0xC6)
+#define GColorCobaltBlue GColorARGB8(GColorCobaltBlueARGB8)
+#define GColorBlueMoonARGB8 ((uint8_t)0xC7)
+#define GColorBlueMoon GColorARGB8(GColorBlueMoonARGB8)
+#define GColorIslamicGreenARGB8 ((uint8_t)0xC8)
+#define GColorIslamicGreen GColorARGB8(GColorIslamicGreenARGB8)
+#define GColorJaegerGreenARGB8 ((uint8_t)0xC9)
+#define GColorJaegerGreen GColorARGB8(GColorJaegerGreenARGB8)
+#define GColorTiffanyBlueARGB8 ((uint8_t)0xCA)
+#define GColorTiffanyBlue GColorARGB8(GColorTiffanyBlueARGB8)
+#define GColorVividCeruleanARGB8 ((uint8_t)0xCB)
+#define GColorVividCerulean GColorARGB8(GColorVividCeruleanARGB8)
+#define GColorGreenARGB8 ((uint8_t)0xCC)
+#define GColorGreen GColorARGB8(GColorGreenARGB8)
+#define GColorMalachiteARGB8 ((uint8_t)0xCD)
+#define GColorMalachite GColorARGB8(GColorMalachiteARGB8)
+#define GColorMediumSpringGreenARGB8 ((uint8_t)0xCE)
+#define GColorMediumSpringGreen GColorARGB8(GColorMediumSpringGreenARGB8)
+#define GColorCyanARGB8 ((uint8_t)0xCF)
+#define GColorCyan GColorARGB8(GColorCyanARGB8)
+#define GColorBulgarianRoseARGB8 ((uint8_t)0xD0)
+#define GColorBulgarianRose GColorARGB8(GColorBulgarianRoseARGB8)
+#define GColorImperialPurpleARGB8 ((uint8_t)0xD1)
+#define GColorImperialPurple GColorARGB8(GColorImperialPurpleARGB8)
+#define GColorIndigoARGB8 ((uint8_t)0xD2)
+#define GColorIndigo GColorARGB8(GColorIndigoARGB8)
+#define GColorElectricUltramarineARGB8 ((uint8_t)0xD3)
+#define GColorElectricUltramarine GColorARGB8(GColorElectricUltramarineARGB8)
+#define GColorArmyGreenARGB8 ((uint8_t)0xD4)
+#define GColorArmyGreen GColorARGB8(GColorArmyGreenARGB8)
+#define GColorDarkGrayARGB8 ((uint8_t)0xD5)
+#define GColorDarkGray GColorARGB8(GColorDarkGrayARGB8)
+#define GColorLibertyARGB8 ((uint8_t)0xD6)
+#define GColorLiberty GColorARGB8(GColorLibertyARGB8)
+#define GColorVeryLightBlueARGB8 ((uint8_t)0xD7)
+#define GColorVeryLightBlue GColorARGB8(GColorVeryLightBlueARGB8)
+#define GColorKellyGreenARGB8 ((uint8_t)0xD8)
+#define GColorKellyGreen GColorARGB8(GColorKellyGreenARGB8)
+#define GColorMayGreenARGB8 ((uint8_t)0xD9)
+#define GColorMayGreen GColorARGB8(GColorMayGreenARGB8)
+#define GColorCadetBlueARGB8 ((uint8_t)0xDA)
+#define GColorCadetBlue GColorARGB8(GColorCadetBlueARGB8)
+#define GColorPictonBlueARGB8 ((uint8_t)0xDB)
+#define GColorPictonBlue GColorARGB8(GColorPictonBlueARGB8)
+#define GColorBrightGreenARGB8 ((uint8_t)0xDC)
+#define GColorBrightGreen GColorARGB8(GColorBrightGreenARGB8)
+#define GColorScreaminGreenARGB8 ((uint8_t)0xDD)
+#define GColorScreaminGreen GColorARGB8(GColorScreaminGreenARGB8)
+#define GColorMediumAquamarineARGB8 ((uint8_t)0xDE)
+#define GColorMediumAquamarine GColorARGB8(GColorMediumAquamarineARGB8)
+#define GColorElectricBlueARGB8 ((uint8_t)0xDF)
+#define GColorElectricBlue GColorARGB8(GColorElectricBlueARGB8)
+#define GColorDarkCandyAppleRedARGB8 ((uint8_t)0xE0)
+#define GColorDarkCandyAppleRed GColorARGB8(GColorDarkCandyAppleRedARGB8)
+#define GColorJazzberryJamARGB8 ((uint8_t)0xE1)
+#define GColorJazzberryJam GColorARGB8(GColorJazzberryJamARGB8)
+#define GColorPurpleARGB8 ((uint8_t)0xE2)
+#define GColorPurple GColorARGB8(GColorPurpleARGB8)
+#define GColorVividVioletARGB8 ((uint8_t)0xE3)
+#define GColorVividViolet GColorARGB8(GColorVividVioletARGB8)
+#define GColorWindsorTanARGB8 ((uint8_t)0xE4)
+#define GColorWindsorTan GColorARGB8(GColorWindsorTanARGB8)
+#define GColorRoseValeARGB8 ((uint8_t)0xE5)
+#define GColorRoseVale GColorARGB8(GColorRoseValeARGB8)
+#define GColorPurpureusARGB8 ((uint8_t)0xE6)
+#define GColorPurpureus GColorARGB8(GColorPurpureusARGB8)
+#define GColorLavenderIndigoARGB8 ((uint8_t)0xE7)
+#define GColorLavenderIndigo GColorARGB8(GColorLavenderIndigoARGB8)
+#define GColorLimerickARGB8 ((uint8_t)0xE8)
+#define GColorLimerick GColorARGB8(GColorLimerickARGB8)
+#define GColorBrassARGB8 ((uint8_t)0xE9)
+#define GColorBrass GColorARGB8(GColorBrassARGB8)
+#define GColorLightGrayARGB8 ((uint8_t)0xEA)
+#define GColorLightGray GColorARGB8(GColorLightGrayARGB8)
+#define GColorBabyBlueEyesARGB8 ((uint8_t)0xEB)
+#define GColorBabyBlueEyes GColorARGB8(GColorBabyBlueEyesARGB8)
+#define GColorSpringBudARGB8 ((uint8_t)0xEC)
+#define GColorSpringBud GColorARGB8(GColorSpringBudARGB8)
+#define GColorInchwormARGB8 ((uint8_t)0xED)
+#define GColorInchworm GColorARGB8(GColorInchwormARGB8)
+#define GColorMintGreenARGB8 ((uint8_t)0xEE)
+#define GColorMintGreen GColorARGB8(GColorMintGreenARGB8)
+#define GColorCelesteARGB8 ((uint8_t)0xEF)
+#define GColorCeleste GColorARGB8(GColorCelesteARGB8)
+#define GColorRedARGB8 ((uint8_t)0xF0)
+#define GColorRed GColorARGB8(GColorRedARGB8)
+#define GColorFollyARGB8 ((uint8_t)0xF1)
+#define GColorFolly GColorARGB8(GColorFollyARGB8)
+#define GColorFashionMagentaARGB8 ((uint8_t)0xF2)
+#define GColorFashionMagenta GColorARGB8(GColorFashionMagentaARGB8)
+#define GColorMagentaARGB8 ((uint8_t)0xF3)
+#define GColorMagenta GColorARGB8(GColorMagentaARGB8)
+#define GColorOrangeARGB8 ((uint8_t)0xF4)
+#define GColorOrange GColorARGB8(GColorOrangeARGB8)
+#define GColorSunsetOrangeARGB8 ((uint8_t)0xF5)
+#define GColorSunsetOrange GColorARGB8(GColorSunsetOrangeARGB8)
+#define GColorBrilliantRoseARGB8 ((uint8_t)0xF6)
+#define GColorBrilliantRose GColorARGB8(GColorBrilliantRoseARGB8)
+#define GColorShockingPinkARGB8 ((uint8_t)0xF7)
+#define GColorShockingPink GColorARGB8(GColorShockingPinkARGB8)
+#define GColorChromeYellowARGB8 ((uint8_t)0xF8)
+#define GColorChromeYellow GColorARGB8(GColorChromeYellowARGB8)
+#define GColorRajahARGB8 ((uint8_t)0xF9)
+#define GColorRajah GColorARGB8(GColorRajahARGB8)
+#define GColorMelonARGB8 ((uint8_t)0xFA)
+#define GColorMelon GColorARGB8(GColorMelonARGB8)
+#define GColorRichBrilliantLavenderARGB8 ((uint8_t)0xFB)
+#define GColorRichBrilliantLavender GColorARGB8(GColorRichBrilliantLavenderARGB8)
+#define GColorYellowARGB8 ((uint8_t)0xFC)
+#define GColorYellow GColorARGB8(GColorYellowARGB8)
+#define GColorIcterineARGB8 ((uint8_t)0xFD)
+#define GColorIcterine GColorARGB8(GColorIcterineARGB8)
+#define GColorPastelYellowARGB8 ((uint8_t)0xFE)
+#define GColorPastelYellow GColorARGB8(GColorPastelYellowARGB8)
+#define GColorWhiteARGB8 ((uint8_t)0xFF)
+#define GColorWhite GColorARGB8(GColorWhiteARGB8)
+bool gcolor_equal(GColor8 a, GColor8 b);
+
+// bitmaps
+typedef enum {
+  GBitmapFormat1Bit = 0,
+  GBitmapFormat8Bit,
+  GBitmapFormat1BitPalette,
+  GBitmapFormat2BitPalette,
+  GBitmapFormat4BitPalette,
+  GBitmapFormat8BitCircular,
+} GBitmapFormat;
+#define GBitmapFormatCircular GBitmapFormat8BitCircular
+
+typedef struct GBitmap GBitmap;
+typedef struct {
+  uint8_t *data; // indexed by x, as on the watch
+  int16_t min_x;
+  int16_t max_x;
+} GBitmapDataRowInfo;
+
+GBitmap *gbitmap_create_blank(GSize size, GBitmapFormat format);
+void gbitmap_destroy(GBitmap *bitmap);
+uint8_t *gbitmap_get_data(const GBitmap *bitmap);
+uint16_t gbitmap_get_bytes_per_row(const GBitmap *bitmap);
+GBitmapFormat gbitmap_get_format(const GBitmap *bitmap);
+GRect gbitmap_get_bounds(const GBitmap *bitmap);
+void gbitmap_set_bounds(GBitmap *bitmap, GRect bounds);
+GBitmapDataRowInfo gbitmap_get_data_row_info(const GBitmap *bitmap, uint16_t y);
+
+// graphics
+typedef struct GContext GContext;
+typedef void *GFont;
+typedef enum { GTextOverflowModeWordWrap, GTextOverflowModeTrailingEllipsis, GTextOverflowModeFill } GTextOverflowMode;
+typedef enum { GTextAlignmentLeft, GTextAlignmentCenter, GTextAlignmentRight } GTextAlignment;
+typedef enum { GCornerNone = 0, GCornersAll = 15 } GCornerMask;
+typedef void *GTextAttributes;
+#define FONT_KEY_GOTHIC_14 "RESOURCE_ID_GOTHIC_14"
+
+GBitmap *graphics_capture_frame_buffer(GContext *ctx);
+bool graphics_release_frame_buffer(GContext *ctx, GBitmap *buffer);
+void graphics_context_set_fill_color(GContext *ctx, GColor color);
+void graphics_context_set_stroke_color(GContext *ctx, GColor color);
+void graphics_context_set_text_color(GContext *ctx, GColor color);
+void graphics_fill_rect(GContext *ctx, GRect rect, uint16_t corner_radius, GCornerMask corner_mask);
+void graphics_draw_bitmap_in_rect(GContext *ctx, const GBitmap *bitmap, GRect rect);
+void graphics_draw_text(GContext *ctx, const char *text, GFont font, GRect box, GTextOverflowMode overflow_mode,
+                        GTextAlignment alignment, GTextAttributes text_attributes);
+GFont fonts_get_system_font(const char *font_key);
+
+// layers
+typedef struct Layer Layer;
+typedef void (*LayerUpdateProc)(Layer *layer, GContext *ctx);
+Layer *layer_create(GRect frame);
+Layer *layer_create_with_data(GRect frame, size_t data_size);
+void layer_destroy(Layer *layer);
+void *layer_get_data(const Layer *layer);
+void layer_add_child(Layer *parent, Layer *child);
+GRect layer_get_frame(const Layer *layer);
+void layer_set_frame(Layer *layer, GRect frame);
+GRect layer_get_bounds(const Layer *layer);
+void layer_set_update_proc(Layer *layer, LayerUpdateProc update_proc);
+void layer_mark_dirty(Layer *layer);
+GPoint layer_convert_point_to_screen(const Layer *layer, GPoint point);
+
+// time and trigonometry
+uint16_t time_ms(time_t *tloc, uint16_t *out_ms);
+#define TRIG_MAX_RATIO 0xffff
+#define TRIG_MAX_ANGLE 0x10000
+int32_t sin_lookup(int32_t angle);
+int32_t cos_lookup(int32_t angle);
+
+// host side only: simulated screen of the platform and drawing of a layer tree onto it
+GBitmap *host_framebuffer_create(void);
+size_t host_framebuffer_size(const GBitmap *framebuffer); // bytes of pixel data
+GContext *host_context_create(GBitmap *framebuffer);
+void host_context_destroy(GContext *ctx);
+void host_context_set_origin(GContext *ctx, GPoint origin); // drawing origin of graphics_* calls, in screen coordinates
+int host_context_captures(GContext *ctx); // framebuffer captures made through the context so far
+void host_render(Layer *root, GContext *ctx); // runs update procs of the tree in drawing order
+void host_set_time_ms(uint64_t ms); // value returned by time_ms
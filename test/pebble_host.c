@@ -0,0 +1,391 @@
+// Host implementation of test/pebble.h: framebuffers laid out as on the watch (Aplite 1bit rows of 20 bytes,
+// Basalt 8bit rows, Chalk 8bit rows cut to the round screen and packed one after another), a graphics context
+// with just enough drawing for effect_mask and effect_fps (rectangles, bitmaps, and text as blocky glyphs),
+// and a layer tree that host_render draws like the system does.
+#include <math.h>
+#include <stdarg.h>
+#include <pebble.h>
+
+#define MAX_ROWS 256
+
+struct GBitmap {
+  uint8_t *data;
+  uint16_t bytes_per_row; // 0 for round framebuffer, whose rows differ in length
+  GBitmapFormat format;
+  GRect bounds;
+  int16_t min_x[MAX_ROWS], max_x[MAX_ROWS];
+  uint32_t row_offset[MAX_ROWS]; // offset of pixel min_x of the row in data
+};
+
+struct GContext {
+  GBitmap *framebuffer;
+  bool captured;
+  int captures; // framebuffer captures so far
+  GPoint origin;
+  GColor fill_color, stroke_color, text_color;
+};
+
+struct Layer {
+  GRect frame;
+  Layer *parent, *first_child, *next_sibling;
+  LayerUpdateProc update_proc;
+  void *data;
+};
+
+static uint64_t s_time_ms;
+
+void host_log(int level, const char *fmt, ...) {
+  va_list args;
+  va_start(args, fmt);
+  fprintf(stderr, "[%d] ", level);
+  vfprintf(stderr, fmt, args);
+  fputc('\n', stderr);
+  va_end(args);
+}
+
+bool gpoint_equal(const GPoint *a, const GPoint *b) {
+  return a->x == b->x && a->y == b->y;
+}
+
+bool grect_equal(const GRect *a, const GRect *b) {
+  return gpoint_equal(&a->origin, &b->origin) && a->size.w == b->size.w && a->size.h == b->size.h;
+}
+
+bool gcolor_equal(GColor8 a, GColor8 b) {
+  return a.argb == b.argb;
+}
+
+//  ********* bitmaps *********
+
+static GBitmap *bitmap_alloc(GSize size, GBitmapFormat format, uint16_t bytes_per_row) {
+  if (size.h > MAX_ROWS) {
+    fprintf(stderr, "bitmap of %d rows is not supported\n", size.h);
+    abort();
+  }
+  GBitmap *bitmap = calloc(1, sizeof(GBitmap));
+  bitmap->format = format;
+  bitmap->bounds = GRect(0, 0, size.w, size.h);
+  bitmap->bytes_per_row = bytes_per_row;
+  for (int y = 0; y < size.h; y++) {
+    bitmap->min_x[y] = 0;
+    bitmap->max_x[y] = size.w - 1;
+    bitmap->row_offset[y] = y * bytes_per_row;
+  }
+  return bitmap;
+}
+
+GBitmap *gbitmap_create_blank(GSize size, GBitmapFormat format) {
+  if (format != GBitmapFormat1Bit && format != GBitmapFormat8Bit) {
+    fprintf(stderr, "gbitmap_create_blank: format %d is not supported on host\n", format);
+    abort();
+  }
+  GBitmap *bitmap = bitmap_alloc(size, format, format == GBitmapFormat1Bit ? (size.w + 31) / 32 * 4 : size.w);
+  bitmap->data = calloc(bitmap->bytes_per_row * size.h, 1);
+  return bitmap;
+}
+
+GBitmap *host_framebuffer_create(void) {
+  GBitmap *fb;
+#if defined(PBL_PLATFORM_APLITE)
+  fb = bitmap_alloc(GSize(PBL_DISPLAY_WIDTH, PBL_DISPLAY_HEIGHT), GBitmapFormat1Bit, 20);
+#elif defined(PBL_ROUND)
+  // rows cut to the circle inscribed in the screen
+  fb = bitmap_alloc(GSize(PBL_DISPLAY_WIDTH, PBL_DISPLAY_HEIGHT), GBitmapFormat8BitCircular, 0);
+  uint32_t offset = 0;
+  for (int y = 0; y < PBL_DISPLAY_HEIGHT; y++) {
+    double radius = PBL_DISPLAY_WIDTH / 2.0, dy = y + 0.5 - PBL_DISPLAY_HEIGHT / 2.0;
+    int half = (int)lround(sqrt(radius*radius - dy*dy));
+    fb->min_x[y] = PBL_DISPLAY_WIDTH / 2 - half;
+    fb->max_x[y] = PBL_DISPLAY_WIDTH / 2 - 1 + half;
+    fb->row_offset[y] = offset;
+    offset += fb->max_x[y] - fb->min_x[y] + 1;
+  }
+#else
+  fb = bitmap_alloc(GSize(PBL_DISPLAY_WIDTH, PBL_DISPLAY_HEIGHT), GBitmapFormat8Bit, PBL_DISPLAY_WIDTH);
+#endif
+  fb->data = calloc(host_framebuffer_size(fb), 1);
+  return fb;
+}
+
+size_t host_framebuffer_size(const GBitmap *framebuffer) {
+  int last = framebuffer->bounds.size.h - 1;
+  if (framebuffer->bytes_per_row) return framebuffer->bytes_per_row * framebuffer->bounds.size.h;
+  return framebuffer->row_offset[last] + framebuffer->max_x[last] - framebuffer->min_x[last] + 1;
+}
+
+void gbitmap_destroy(GBitmap *bitmap) {
+  if (!bitmap) return;
+  free(bitmap->data);
+  free(bitmap);
+}
+
+uint8_t *gbitmap_get_data(const GBitmap *bitmap) {
+  return bitmap->data;
+}
+
+uint16_t gbitmap_get_bytes_per_row(const GBitmap *bitmap) {
+  return bitmap->bytes_per_row;
+}
+
+GBitmapFormat gbitmap_get_format(const GBitmap *bitmap) {
+  return bitmap->format;
+}
+
+GRect gbitmap_get_bounds(const GBitmap *bitmap) {
+  return bitmap->bounds;
+}
+
+void gbitmap_set_bounds(GBitmap *bitmap, GRect bounds) {
+  bitmap->bounds = bounds;
+}
+
+GBitmapDataRowInfo gbitmap_get_data_row_info(const GBitmap *bitmap, uint16_t y) {
+  if (y >= bitmap->bounds.size.h) {
+    fprintf(stderr, "gbitmap_get_data_row_info: row %d out of bounds\n", y);
+    abort();
+  }
+  return (GBitmapDataRowInfo){ bitmap->data + bitmap->row_offset[y] - bitmap->min_x[y], bitmap->min_x[y], bitmap->max_x[y] };
+}
+
+// pixel of any supported bitmap as 8bit color
+static GColor bitmap_get_color(const GBitmap *bitmap, int x, int y) {
+  GBitmapDataRowInfo row = gbitmap_get_data_row_info(bitmap, y);
+  if (bitmap->format == GBitmapFormat1Bit) return ((row.data[x / 8] >> (x % 8)) & 1) ? GColorWhite : GColorBlack;
+  return GColorARGB8(row.data[x]);
+}
+
+// sets framebuffer pixel at screen coordinates, if visible; 1bit framebuffer shows white as 1 and the rest as 0
+static void framebuffer_set_color(GBitmap *fb, int x, int y, GColor color) {
+  if (y < 0 || y >= fb->bounds.size.h || x < fb->min_x[y] || x > fb->max_x[y]) return;
+  GBitmapDataRowInfo row = gbitmap_get_data_row_info(fb, y);
+  if (fb->format == GBitmapFormat1Bit) {
+    uint8_t bit = 1 << (x % 8);
+    row.data[x / 8] = gcolor_equal(color, GColorWhite) ? row.data[x / 8] | bit : row.data[x / 8] & ~bit;
+  } else {
+    row.data[x] = color.argb;
+  }
+}
+
+//  ********* graphics *********
+
+GContext *host_context_create(GBitmap *framebuffer) {
+  GContext *ctx = calloc(1, sizeof(GContext));
+  ctx->framebuffer = framebuffer;
+  ctx->fill_color = ctx->stroke_color = ctx->text_color = GColorBlack;
+  return ctx;
+}
+
+void host_context_destroy(GContext *ctx) {
+  free(ctx);
+}
+
+void host_context_set_origin(GContext *ctx, GPoint origin) {
+  ctx->origin = origin;
+}
+
+int host_context_captures(GContext *ctx) {
+  return ctx->captures;
+}
+
+// the SDK hands the framebuffer out once until it is released, and ignores drawing meanwhile - here both are errors
+GBitmap *graphics_capture_frame_buffer(GContext *ctx) {
+  if (ctx->captured) {
+    fprintf(stderr, "graphics_capture_frame_buffer: framebuffer is already captured\n");
+    abort();
+  }
+  ctx->captured = true;
+  ctx->captures++;
+  return ctx->framebuffer;
+}
+
+bool graphics_release_frame_buffer(GContext *ctx, GBitmap *buffer) {
+  if (!ctx->captured || buffer != ctx->framebuffer) {
+    fprintf(stderr, "graphics_release_frame_buffer: framebuffer was not captured\n");
+    abort();
+  }
+  ctx->captured = false;
+  return true;
+}
+
+static void check_not_captured(GContext *ctx, const char *function) {
+  if (ctx->captured) {
+    fprintf(stderr, "%s: drawing while the framebuffer is captured\n", function);
+    abort();
+  }
+}
+
+void graphics_context_set_fill_color(GContext *ctx, GColor color) {
+  ctx->fill_color = color;
+}
+
+void graphics_context_set_stroke_color(GContext *ctx, GColor color) {
+  ctx->stroke_color = color;
+}
+
+void graphics_context_set_text_color(GContext *ctx, GColor color) {
+  ctx->text_color = color;
+}
+
+void graphics_fill_rect(GContext *ctx, GRect rect, uint16_t corner_radius, GCornerMask corner_mask) {
+  check_not_captured(ctx, __func__);
+  if (gcolor_equal(ctx->fill_color, GColorClear)) return;
+  for (int y = 0; y < rect.size.h; y++)
+    for (int x = 0; x < rect.size.w; x++)
+      framebuffer_set_color(ctx->framebuffer, ctx->origin.x + rect.origin.x + x, ctx->origin.y + rect.origin.y + y, ctx->fill_color);
+}
+
+// bitmap is tiled over rect, as the SDK does
+void graphics_draw_bitmap_in_rect(GContext *ctx, const GBitmap *bitmap, GRect rect) {
+  check_not_captured(ctx, __func__);
+  GRect bounds = gbitmap_get_bounds(bitmap);
+  for (int y = 0; y < rect.size.h; y++)
+    for (int x = 0; x < rect.size.w; x++)
+      framebuffer_set_color(ctx->framebuffer, ctx->origin.x + rect.origin.x + x, ctx->origin.y + rect.origin.y + y,
+                            bitmap_get_color(bitmap, x % bounds.size.w, y % bounds.size.h));
+}
+
+// text is drawn in 6x10 cells holding a 5x8 block pattern derived from the character, lines wrap at the box width
+#define GLYPH_WIDTH 6
+#define GLYPH_HEIGHT 10
+
+void graphics_draw_text(GContext *ctx, const char *text, GFont font, GRect box, GTextOverflowMode overflow_mode,
+                        GTextAlignment alignment, GTextAttributes text_attributes) {
+  check_not_captured(ctx, __func__);
+  int per_line = box.size.w / GLYPH_WIDTH;
+  if (per_line <= 0) return;
+  int length = strlen(text);
+
+  for (int start = 0, line = 0; start < length; start += per_line, line++) {
+    int count = length - start < per_line ? length - start : per_line;
+    int free_space = box.size.w - count * GLYPH_WIDTH;
+    int x0 = box.origin.x + (alignment == GTextAlignmentCenter ? free_space / 2 : alignment == GTextAlignmentRight ? free_space : 0);
+    int y0 = box.origin.y + line * GLYPH_HEIGHT;
+    if (y0 + GLYPH_HEIGHT > box.origin.y + box.size.h) break;
+
+    for (int i = 0; i < count; i++) {
+      unsigned char c = text[start + i];
+      if (c == ' ') continue;
+      uint64_t pattern = (c + 1) * 0x9E3779B97F4A7C15ull;
+      for (int gy = 0; gy < 8; gy++)
+        for (int gx = 0; gx < 5; gx++)
+          if ((pattern >> (gx + 5*gy)) & 1 || gx == 0 || gy == 7) // glyphs get a left and bottom stroke so none is empty
+            framebuffer_set_color(ctx->framebuffer, ctx->origin.x + x0 + i*GLYPH_WIDTH + gx, ctx->origin.y + y0 + gy, ctx->text_color);
+    }
+  }
+}
+
+GFont fonts_get_system_font(const char *font_key) {
+  return (GFont)font_key;
+}
+
+//  ********* layers *********
+
+Layer *layer_create(GRect frame) {
+  Layer *layer = calloc(1, sizeof(Layer));
+  layer->frame = frame;
+  return layer;
+}
+
+Layer *layer_create_with_data(GRect frame, size_t data_size) {
+  Layer *layer = layer_create(frame);
+  layer->data = calloc(1, data_size);
+  return layer;
+}
+
+static void layer_remove_from_parent(Layer *layer) {
+  if (!layer->parent) return;
+  Layer **link = &layer->parent->first_child;
+  while (*link != layer) link = &(*link)->next_sibling;
+  *link = layer->next_sibling;
+  layer->parent = NULL;
+  layer->next_sibling = NULL;
+}
+
+void layer_destroy(Layer *layer) {
+  if (!layer) return;
+  layer_remove_from_parent(layer);
+  while (layer->first_child) layer_remove_from_parent(layer->first_child);
+  free(layer->data);
+  free(layer);
+}
+
+void *layer_get_data(const Layer *layer) {
+  return layer->data;
+}
+
+// children are drawn in the order they were added, above their parent
+void layer_add_child(Layer *parent, Layer *child) {
+  layer_remove_from_parent(child);
+  Layer **link = &parent->first_child;
+  while (*link) link = &(*link)->next_sibling;
+  *link = child;
+  child->parent = parent;
+}
+
+GRect layer_get_frame(const Layer *layer) {
+  return layer->frame;
+}
+
+void layer_set_frame(Layer *layer, GRect frame) {
+  layer->frame = frame;
+}
+
+GRect layer_get_bounds(const Layer *layer) {
+  return GRect(0, 0, layer->frame.size.w, layer->frame.size.h);
+}
+
+void layer_set_update_proc(Layer *layer, LayerUpdateProc update_proc) {
+  layer->update_proc = update_proc;
+}
+
+void layer_mark_dirty(Layer *layer) {
+}
+
+GPoint layer_convert_point_to_screen(const Layer *layer, GPoint point) {
+  for (; layer; layer = layer->parent) {
+    point.x += layer->frame.origin.x;
+    point.y += layer->frame.origin.y;
+  }
+  return point;
+}
+
+void host_render(Layer *root, GContext *ctx) {
+  host_context_set_origin(ctx, layer_convert_point_to_screen(root, GPointZero));
+  if (root->update_proc) root->update_proc(root, ctx);
+  for (Layer *child = root->first_child; child; child = child->next_sibling) host_render(child, ctx);
+}
+
+//  ********* time and trigonometry *********
+
+void host_set_time_ms(uint64_t ms) {
+  s_time_ms = ms;
+}
+
+uint16_t time_ms(time_t *tloc, uint16_t *out_ms) {
+  if (tloc) *tloc = s_time_ms / 1000;
+  if (out_ms) *out_ms = s_time_ms % 1000;
+  return s_time_ms % 1000;
+}
+
+// tables as on the watch, so timings of code using them are not those of libm
+static int32_t s_sin_table[TRIG_MAX_ANGLE], s_cos_table[TRIG_MAX_ANGLE];
+
+static void build_trig_tables(void) {
+  static bool built;
+  if (built) return;
+  for (int angle = 0; angle < TRIG_MAX_ANGLE; angle++) {
+    s_sin_table[angle] = (int32_t)lround(sin(angle * 2 * M_PI / TRIG_MAX_ANGLE) * TRIG_MAX_RATIO);
+    s_cos_table[angle] = (int32_t)lround(cos(angle * 2 * M_PI / TRIG_MAX_ANGLE) * TRIG_MAX_RATIO);
+  }
+  built = true;
+}
+
+int32_t sin_lookup(int32_t angle) {
+  build_trig_tables();
+  return s_sin_table[angle & (TRIG_MAX_ANGLE - 1)];
+}
+
+int32_t cos_lookup(int32_t angle) {
+  build_trig_tables();
+  return s_cos_table[angle & (TRIG_MAX_ANGLE - 1)];
+}